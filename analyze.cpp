@@ -0,0 +1,390 @@
+// Batch position analysis for the Othello AI.
+//
+//   analyze [-depth N] [-time MS] [-solve EMPTIES] [-threads N] [-hash MB]
+//           [FILE]
+//
+// Reads positions from FILE, or from stdin if there is none, one per line
+// as for perft: the 64 squares in setBoard order ('b', 'w', or anything
+// else for an empty square) and the side to move ('b' or 'w'). Writes one
+// line for every input line, in input order:
+//   SQUARES SIDE MOVE SCORE DEPTH NODES
+// MOVE is "a1" to "h8", "pass" if the side to move has to pass (the other
+// side's position is then searched), or "none" if the game is over. SCORE
+// is in discs for the side to move, DEPTH is the depth of the last
+// completed iteration, or the number of empties for an exact solve. Lines
+// that are not positions are copied with "invalid" after them.
+//
+// Positions are searched to -depth plies (default 8), or for -time
+// milliseconds each if that is given instead; positions with -solve
+// (default 14) or fewer empty squares are solved exactly, with no time
+// limit. The positions are shared out over -threads workers (default one
+// per core), each with its own search and a -hash MB transposition table
+// (default 16) that it keeps between positions, so with more than one
+// thread the nodes, and now and then a move or score, can differ from run
+// to run. Input is read at most WINDOW_PER_THREAD positions ahead of the
+// output, so memory use does not grow with the input, and the output is
+// flushed whenever the next result is still being searched. Like the
+// player, analyze uses the weights and ProbCut files in the current
+// directory if there are any.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "board.hpp"
+#include "search.hpp"
+#include "endgame.hpp"
+#include "eval.hpp"
+#include "probcut.hpp"
+using namespace std;
+
+const int DEFAULT_ANALYZE_DEPTH = 8;
+const int DEFAULT_SOLVE_EMPTIES = 14;
+const int DEFAULT_ANALYZE_HASH_MB = 16;
+const int WINDOW_PER_THREAD = 64;
+const int MAX_LINE = 256;
+
+struct AnalyzeOptions {
+  int depth;
+  int ms; // 0 for a fixed depth
+  int solveEmpties;
+};
+
+// a line of input on its way through the workers
+struct Job {
+  char line[MAX_LINE];
+  char result[MAX_LINE + 64];
+  bool done;
+};
+
+// the window of jobs between the reader and the output. job i lives in
+// slot i % slots.size(); jobs below written have been printed, jobs below
+// taken are with a worker or done, and jobs below read are waiting
+struct JobQueue {
+  vector<Job> slots;
+  long long read;
+  long long taken;
+  long long written;
+  bool finished; // no more input
+  mutex lock;
+  condition_variable work; // a job was read, or the input finished
+  condition_variable results; // a job is done
+};
+
+// "a1" to "h8"
+static string squareName(int square)
+{
+  string name;
+  name += (char) ('a' + (square & 7));
+  name += (char) ('1' + (square >> 3));
+  return name;
+}
+
+// parses the 64 squares and the side. returns false if the line is not a
+// position
+static bool parsePosition(const char *line, Board *board, Side *side)
+{
+  if (strlen(line) < 66 || (line[65] != 'b' && line[65] != 'w')
+   || (line[64] != ' ' && line[64] != '\t')
+   || (line[66] != 0 && line[66] != ' ' && line[66] != '\t'))
+  {
+    return false;
+  }
+  char squares[64];
+  memcpy(squares, line, 64);
+  board->setBoard(squares);
+  *side = (line[65] == 'b') ? BLACK : WHITE;
+  return true;
+}
+
+// analyzes the position on one line and writes the output line to result
+static void analyze(const char *line, const AnalyzeOptions &options,
+                    TranspositionTable *tt, const Evaluator *eval,
+                    const ProbCut *probcut, char *result, size_t size)
+{
+  Board board;
+  Side side;
+  if (!parsePosition(line, &board, &side))
+  {
+    snprintf(result, size, "%s invalid", line);
+    return;
+  }
+  string move;
+  int score;
+  int depth = 0;
+  long long nodes = 0;
+  Side mover = side;
+  if (!board.hasMoves(side))
+  {
+    if (!board.hasMoves(flip(side)))
+    {
+      snprintf(result, size, "%.66s none %+.2f 0 0", line,
+               (double) (board.count(side) - board.count(flip(side))));
+      return;
+    }
+    mover = flip(side);
+  }
+  int empties = board.countEmpty();
+  Move best;
+  if (empties <= options.solveEmpties)
+  {
+    EndgameSolver solver(tt);
+    score = solver.solve(board, mover, SOLVE_EXACT, nullptr, &best)
+          * DISC_WIN_SCALE;
+    depth = empties;
+    nodes = solver.nodes;
+  }
+  else
+  {
+    tt->newSearch();
+    Search search(tt, eval, probcut);
+    if (options.ms > 0)
+    {
+      // a fixed budget for this one position, rather than a share of a
+      // clock
+      TimeManager timer;
+      timer.start(options.ms, empties);
+      timer.softLimitMs = options.ms / 2;
+      timer.hardLimitMs = options.ms;
+      score = search.iterativeDeepening(board, mover, MAX_DEPTH, &timer,
+                                        &best);
+    }
+    else
+    {
+      score = search.iterativeDeepening(board, mover, options.depth, nullptr,
+                                        &best);
+    }
+    depth = search.completedDepth;
+    nodes = search.nodes;
+    if (depth == 0)
+    {
+      // out of time before the first iteration was done
+      score = search.iterativeDeepening(board, mover, 1, nullptr, &best);
+      depth = 1;
+      nodes += search.nodes;
+    }
+  }
+  if (mover != side)
+  {
+    move = "pass";
+    score = -score;
+  }
+  else
+  {
+    move = squareName(best.square);
+  }
+  snprintf(result, size, "%.66s %s %+.2f %d %lld", line, move.c_str(),
+           (double) score / DISC_WIN_SCALE, depth, nodes);
+}
+
+static void worker(JobQueue *queue, const AnalyzeOptions &options,
+                   int hashMB, const Evaluator *eval, const ProbCut *probcut)
+{
+  TranspositionTable tt(hashMB);
+  unique_lock<mutex> guard(queue->lock);
+  while (true)
+  {
+    queue->work.wait(guard, [&]() {
+      return queue->taken < queue->read || queue->finished;
+    });
+    if (queue->taken == queue->read)
+    {
+      return; // finished, and nothing left to take
+    }
+    Job &job = queue->slots[queue->taken++ % queue->slots.size()];
+    guard.unlock();
+    analyze(job.line, options, &tt, eval, probcut, job.result,
+            sizeof(job.result));
+    guard.lock();
+    job.done = true;
+    queue->results.notify_one();
+  }
+}
+
+// prints the results that are done, in order. called with the lock held
+static void writeResults(JobQueue *queue)
+{
+  while (queue->written < queue->taken)
+  {
+    Job &job = queue->slots[queue->written % queue->slots.size()];
+    if (!job.done)
+    {
+      return;
+    }
+    printf("%s\n", job.result);
+    queue->written++;
+  }
+}
+
+// reads a line without its newline. longer lines are cut to fit, and the
+// rest is skipped. returns false at the end of the input
+static bool readLine(FILE *file, char *line, int size)
+{
+  if (fgets(line, size, file) == nullptr)
+  {
+    return false;
+  }
+  size_t length = strlen(line);
+  if (length > 0 && line[length - 1] == '\n')
+  {
+    line[--length] = 0;
+  }
+  else
+  {
+    int c;
+    while ((c = fgetc(file)) != EOF && c != '\n') {}
+  }
+  if (length > 0 && line[length - 1] == '\r')
+  {
+    line[--length] = 0;
+  }
+  return true;
+}
+
+int main(int argc, char *argv[])
+{
+  AnalyzeOptions options;
+  options.depth = DEFAULT_ANALYZE_DEPTH;
+  options.ms = 0;
+  options.solveEmpties = DEFAULT_SOLVE_EMPTIES;
+  int threads = thread::hardware_concurrency();
+  int hashMB = DEFAULT_ANALYZE_HASH_MB;
+  const char *path = nullptr;
+  bool ok = true;
+  int i = 1;
+  for (; ok && i + 1 < argc && argv[i][0] == '-'; i += 2)
+  {
+    int value = atoi(argv[i + 1]);
+    if (!strcmp(argv[i], "-depth"))
+    {
+      options.depth = value;
+      ok = value >= 1 && value <= MAX_DEPTH;
+    }
+    else if (!strcmp(argv[i], "-time"))
+    {
+      options.ms = value;
+      ok = value >= 1;
+    }
+    else if (!strcmp(argv[i], "-solve"))
+    {
+      options.solveEmpties = value;
+      ok = value >= 0 && value <= 64;
+    }
+    else if (!strcmp(argv[i], "-threads"))
+    {
+      threads = value;
+      ok = value >= 1;
+    }
+    else if (!strcmp(argv[i], "-hash"))
+    {
+      hashMB = value;
+      ok = value >= 1;
+    }
+    else
+    {
+      ok = false;
+    }
+  }
+  if (ok && i == argc - 1)
+  {
+    path = argv[i];
+  }
+  else
+  {
+    ok = ok && i == argc;
+  }
+  if (!ok)
+  {
+    fprintf(stderr, "usage: %s [-depth N] [-time MS] [-solve EMPTIES] "
+                    "[-threads N] [-hash MB] [FILE]\n", argv[0]);
+    return 1;
+  }
+  threads = max(threads, 1);
+  FILE *input = stdin;
+  if (path != nullptr && (input = fopen(path, "r")) == nullptr)
+  {
+    fprintf(stderr, "could not read %s\n", path);
+    return 1;
+  }
+
+  Evaluator eval;
+  eval.load(DEFAULT_WEIGHTS_FILE);
+  ProbCut probcut;
+  probcut.load(DEFAULT_PROBCUT_FILE);
+  JobQueue queue;
+  queue.slots.resize(threads * WINDOW_PER_THREAD);
+  queue.read = 0;
+  queue.taken = 0;
+  queue.written = 0;
+  queue.finished = false;
+  vector<thread> workers;
+  for (int t = 0; t < threads; t++)
+  {
+    workers.push_back(thread(worker, &queue, cref(options), hashMB, &eval,
+                             &probcut));
+  }
+
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  char line[MAX_LINE];
+  unique_lock<mutex> guard(queue.lock);
+  while (true)
+  {
+    // the next slot is free once its last job has been printed
+    while (queue.read - queue.written == (long long) queue.slots.size())
+    {
+      writeResults(&queue);
+      if (queue.read - queue.written == (long long) queue.slots.size())
+      {
+        fflush(stdout);
+        queue.results.wait(guard);
+      }
+    }
+    guard.unlock();
+    bool more = readLine(input, line, sizeof(line));
+    guard.lock();
+    if (!more)
+    {
+      break;
+    }
+    Job &job = queue.slots[queue.read % queue.slots.size()];
+    memcpy(job.line, line, sizeof(line));
+    job.done = false;
+    queue.read++;
+    queue.work.notify_one();
+    writeResults(&queue);
+  }
+  queue.finished = true;
+  queue.work.notify_all();
+  while (queue.written < queue.read)
+  {
+    writeResults(&queue);
+    if (queue.written < queue.read)
+    {
+      fflush(stdout);
+      queue.results.wait(guard);
+    }
+  }
+  guard.unlock();
+  for (size_t t = 0; t < workers.size(); t++)
+  {
+    workers[t].join();
+  }
+  fflush(stdout);
+  if (input != stdin)
+  {
+    fclose(input);
+  }
+
+  double seconds = chrono::duration<double>(chrono::steady_clock::now()
+                                            - start).count();
+  fprintf(stderr, "%lld positions in %.2f s, %.1f positions/s, %d threads\n",
+          queue.read, seconds, (seconds > 0) ? queue.read / seconds : 0.0,
+          threads);
+  return 0;
+}
@@ -0,0 +1,354 @@
+// Search benchmark for the Othello AI.
+//
+//   bench [-depth N] [-time MS] [-threads N] [-hash MB] [-format json|csv]
+//
+// Runs the engine on a fixed set of positions, first to a fixed depth
+// (default 10) and then for a fixed time per position (default 500 ms).
+// Positions with ENDGAME_SOLVE_EMPTIES or fewer empty squares are solved
+// exactly instead, as the player would. In the timed pass, again as in
+// the player, a shallow search is done before the solve, and a solve that
+// runs out of time reports that search's move, depth and score; both
+// count towards the position's nodes and time. Either pass is skipped if
+// its option is 0. The transposition table is cleared before every position.
+//
+// Prints, as JSON (the default) or CSV, every position's nodes, time, nodes
+// per second, depth reached, best move and score, and the totals of each
+// pass. The signature is a hash of the nodes, moves and scores of the
+// fixed-depth pass: it changes whenever the search does, and with one
+// thread (the default) it is the same on every run of the same build, so
+// a change in it from a commit that meant to change speed only is a bug.
+// Like the player, bench uses the weights and ProbCut files in the current
+// directory if there are any.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "board.hpp"
+#include "search.hpp"
+#include "smp.hpp"
+#include "endgame.hpp"
+#include "eval.hpp"
+#include "probcut.hpp"
+using namespace std;
+
+const int ENDGAME_SOLVE_EMPTIES = 20;
+const int DEFAULT_BENCH_DEPTH = 10;
+const int DEFAULT_BENCH_MS = 500;
+const int DEFAULT_BENCH_HASH_MB = 64;
+
+// 40 midgame positions from 50 down to 21 empties, then 10 endgame ones
+// from 16 down to 12, each as the 64 squares in setBoard order and the
+// side to move. they come from games played mostly by 2-ply searches
+static const char *POSITIONS[] = {
+  "---b-------b-------b-----wwww-----wwbw---b-w--w----------------- b",
+  "------------------www-----www-----wbwwww---bb------------------- b",
+  "--b-w------b------wbb-----wbbb----wbww------b------------------- w",
+  "----------------w-wbb----wwbbw----wbww----bwb------------------- b",
+  "----w-------w-----wbw-----bww----bbbwb------w------bw----------- b",
+  "--b-------b-b---w-bwb----wbbw-----bbbw----b-b------------------- w",
+  "-----b------b------bbb----wbb------wwbw----ww-b----www---------- b",
+  "----------------w--b-w--w--bb---wbbwbb--wwb-b-----b-------bw---- w",
+  "---w------ww----bbbb------bwbb-----bb----wwwbw------b----------- w",
+  "-b-b-w----bbw------bwb-b--wbwwb---bbwb------w------------------- b",
+  "----------w-----wwww-b--wbwbb---w-wbww--www-b-----w------------- w",
+  "---b-------b----w--b----bw-bb-b-wbwwwb----bbw------b-w----b-w--- b",
+  "----bbb----bw----wwwbb--w-wbw---wwbwb---w-b--b------------------ b",
+  "--w-------ww------wwwb----bbbbb-wwbbbw----bwwww----------------- w",
+  "--w-------www---bbbww--b--wwb-b---wwbbb---wwb------w-------w---- b",
+  "---w-w-w---bwbww--wbbw-w--bbbb----bbwb----w--b-------bw--------- w",
+  "---bbb---wb-bb----bbbb---wbww-----bbwb------ww------w------www-- w",
+  "-----b------bww---bbww----bbw---wwwwbbbb-ww-b------wbb------b--- b",
+  "------b--wb--b--b-wbb----bbbbb--wbbwwwwwwwbbb---w--------------- w",
+  "---b-------wbw--w-wwwb-w-wbwbwb--bwwbw-bb-w-b-----w-b-------b--- b",
+  "w---www--w-wb---wbwbwb---bbwwwww-bwbbb--b-b-b------------------- b",
+  "bbbbbb---ww-----wwbw-b----bbbbb---bbwb----b-bwb----b--w---b----- w",
+  "-b-w------bbb---w--bb----w-wbb--bbwwwb---b-w-w--wwwwwww--w-b---- b",
+  "--w-www---wwww--w-wwww--bbbwbb--bbwwww--bw--b-w-w------w-------- w",
+  "wwww---w--bbb-w----bbww---bbbw---bwwww--b-wwb-w----wb--w--w----- w",
+  "-b-b-w-w--bbww-w---bbwwwbbbbbb---wwbwwwwwwbbb------------------- b",
+  "bbb-bw---bb--bw---bbbwb--wbwwb-wbwbwbww--bbbww----b------------- w",
+  "-bbbbb----bwb---wwwbw-----bbbwbb-bbbwww----wwwww----w-------bbb- b",
+  "w---b----w--bb--wbwwb----bwwwwwwwwbwbbbbwb--w--w---www------b-w- b",
+  "www-www--bbbb-----bbw----bbbbbb-bbbbbbwwwww-bbb-----b-------b--- w",
+  "--wbbbb----wb-b--wbbw-b--wwbwwbw-bwbb-b----bbbb----bww------wwww b",
+  "--b-www-b-wwww---bwbbb--wwbwbbbbwwwbbb--ww--bb--ww-b----w-b----- w",
+  "wbw--w--wbbw-wbwwbbbbbwb--bwbw-----wbb-----bbbbw--b--www------ww w",
+  "--ww-b----wwb---wwwbwbww-wwwbwww--wbwbww--bwb----bwb-b---ww-b-b- b",
+  "w--b-----w-b--w-w-wb--wb-wwbwww-bbbbbbw-bbbbb--w-bbww---bbw-bbb- w",
+  "-w-bbb--w-wwb---wwwwwbw-wwbwb-b--wwwwbwwbwwwwww-----ww-b----w-b- b",
+  "w--wwwww-w--ww----wwwww----www-bbbwwwwb--bbwwbwww-wwb--w--w-b--w b",
+  "-b-w-b----bww---wwwbww-w-bbww-w-bbwwwbw-bbbbbbbb-w-ww-bb--w-b--b w",
+  "wwww---b--bww-b-wwwbwbbb--wwbb--wwwbwbw-wwbw-bww--bb-b---bbbb--- b",
+  "wwwwwww-wwwwww--wwwwwbbbwwwww--bwwwwwwb---w-wb-----wwbb-----w--b b",
+  "-bbbbbbb--bbbbb-wwbwbbbw--wwbbw-bbbbbwbb--bbwwb---bbbbwb--w-b-ww b",
+  "wwwwwwww--bbbbbb--bbbbww-wbbbw-wwwwbwwbw--bwbw-w---bw-ww--wbbw-w b",
+  "-wbbb-w---wbbbw-w-bwb-wb-wwbwwbb-wbbwwwbwbwwb-wbbwwbbb-bw--b-bb- b",
+  "-www-bbbwww-bb--wwbbwb---bwbbbwwbwwwbb--b-bwwbb-bbbbbw-bbbbbb-w- w",
+  "bbbbbbww--bbbwwwwbbbbbbwwbbbbbbwwbwbwbbwwwbbb--ww--bb--w----b--- w",
+  "bbbbbb---bw-b----bwwwww--bwwww-wwbwwwwwbwb-wwbwbwbwwbwwb-w-bbbbb b",
+  "bbbbbbb-bbbbbb--bbbbbb--bwbbbbb-bbwbbb-wbbbbbww-b-b-ww-b--b-bwww b",
+  "-bbbbwww---bbwww--bwbwwwbbbbbbwwwbwwbbwwwbbwbw-bbbbbbb--b--bb-b- w",
+  "bbbb-b-wb-b---wwbwbwbwwwb-bbww-wbwbbwwwwbbbbww-wbbbbww-ww-w-bbb- w",
+  "bbb-bbbb-wb-bbwb--wbwwwb--wwwbbb-wwbwbbbwwwbbbwbwwwb-bbbwww--b-b b"
+};
+
+struct BenchResult {
+  int empties;
+  int depth; // completed depth; the number of empties if solved
+  long long nodes;
+  double seconds;
+  int move;
+  int score; // in Search's units
+  // if a solve ran out of time, the move, depth and score are those of the
+  // fallback search
+};
+
+struct BenchTotals {
+  long long nodes;
+  double seconds;
+};
+
+static void parsePosition(const char *text, Board *board, Side *side)
+{
+  char squares[64];
+  memcpy(squares, text, 64);
+  board->setBoard(squares);
+  *side = (text[65] == 'b') ? BLACK : WHITE;
+}
+
+// searches one position. depth is the depth limit, or timer is the time
+// limit, as in Player::searchMove
+static BenchResult runPosition(const Board &board, Side side, int depth,
+                               const TimeManager *timer,
+                               TranspositionTable *tt, const Evaluator *eval,
+                               const ProbCut *probcut, int threads)
+{
+  BenchResult result;
+  result.empties = board.countEmpty();
+  Move best;
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  if (result.empties <= ENDGAME_SOLVE_EMPTIES)
+  {
+    // with a time limit, a shallow search first as the player does, so
+    // that a solve that runs out of time still has a move to report
+    Search fallback(tt, eval);
+    int fallbackScore = 0;
+    if (timer != nullptr)
+    {
+      fallbackScore = fallback.iterativeDeepening(board, side,
+                                                  ENDGAME_FALLBACK_DEPTH,
+                                                  nullptr, &best);
+    }
+    EndgameSolver solver(tt);
+    Move solved;
+    int score = solver.solve(board, side, SOLVE_EXACT, timer, &solved);
+    result.nodes = fallback.nodes + solver.nodes;
+    if (solver.aborted)
+    {
+      result.depth = fallback.completedDepth;
+      result.score = fallbackScore;
+    }
+    else
+    {
+      best = solved;
+      result.depth = result.empties;
+      result.score = score * DISC_WIN_SCALE;
+    }
+  }
+  else
+  {
+    ParallelSearch search(tt, eval, threads, probcut);
+    result.score = search.iterativeDeepening(board, side,
+                                             timer ? MAX_DEPTH : depth,
+                                             timer, &best);
+    result.depth = search.completedDepth;
+    result.nodes = search.nodes;
+  }
+  result.seconds = chrono::duration<double>(chrono::steady_clock::now()
+                                            - start).count();
+  result.move = best.square;
+  return result;
+}
+
+// "a1" to "h8", or "none" for NO_MOVE
+static string squareName(int square)
+{
+  if (square == NO_MOVE)
+  {
+    return "none";
+  }
+  string name;
+  name += (char) ('a' + (square & 7));
+  name += (char) ('1' + (square >> 3));
+  return name;
+}
+
+static double nps(long long nodes, double seconds)
+{
+  return (seconds > 0) ? nodes / seconds : 0.0;
+}
+
+// FNV-1a over the results, which only depend on the search
+static uint64_t signature(const vector<BenchResult> &results)
+{
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < results.size(); i++)
+  {
+    long long values[3] = {results[i].nodes, results[i].move,
+                           results[i].score};
+    for (int v = 0; v < 3; v++)
+    {
+      for (int byte = 0; byte < 8; byte++)
+      {
+        hash ^= (uint64_t) (values[v] >> (8 * byte)) & 0xff;
+        hash *= 1099511628211ULL;
+      }
+    }
+  }
+  return hash;
+}
+
+static BenchTotals totals(const vector<BenchResult> &results)
+{
+  BenchTotals t = {0, 0.0};
+  for (size_t i = 0; i < results.size(); i++)
+  {
+    t.nodes += results[i].nodes;
+    t.seconds += results[i].seconds;
+  }
+  return t;
+}
+
+static void printJSONPass(const char *name, const vector<BenchResult> &results,
+                          bool last)
+{
+  BenchTotals t = totals(results);
+  printf("  \"%s\": {\n    \"positions\": [\n", name);
+  for (size_t i = 0; i < results.size(); i++)
+  {
+    const BenchResult &r = results[i];
+    printf("      {\"position\": %d, \"empties\": %d, \"depth\": %d, "
+           "\"nodes\": %lld, \"ms\": %.1f, \"nps\": %.0f, \"move\": \"%s\", "
+           "\"score\": %d}%s\n", (int) i + 1, r.empties, r.depth, r.nodes,
+           r.seconds * 1000, nps(r.nodes, r.seconds),
+           squareName(r.move).c_str(), r.score,
+           (i + 1 < results.size()) ? "," : "");
+  }
+  printf("    ],\n    \"nodes\": %lld, \"ms\": %.1f, \"nps\": %.0f\n  }%s\n",
+         t.nodes, t.seconds * 1000, nps(t.nodes, t.seconds), last ? "" : ",");
+}
+
+static void printCSVPass(const char *name, const vector<BenchResult> &results)
+{
+  for (size_t i = 0; i < results.size(); i++)
+  {
+    const BenchResult &r = results[i];
+    printf("%s,%d,%d,%d,%lld,%.1f,%.0f,%s,%d\n", name, (int) i + 1,
+           r.empties, r.depth, r.nodes, r.seconds * 1000,
+           nps(r.nodes, r.seconds), squareName(r.move).c_str(), r.score);
+  }
+  BenchTotals t = totals(results);
+  printf("%s,total,,,%lld,%.1f,%.0f,,\n", name, t.nodes, t.seconds * 1000,
+         nps(t.nodes, t.seconds));
+}
+
+int main(int argc, char *argv[])
+{
+  int depth = DEFAULT_BENCH_DEPTH;
+  int ms = DEFAULT_BENCH_MS;
+  int threads = 1;
+  int hashMB = DEFAULT_BENCH_HASH_MB;
+  bool csv = false;
+  bool ok = argc % 2 == 1;
+  for (int i = 1; ok && i + 1 < argc; i += 2)
+  {
+    if (!strcmp(argv[i], "-depth"))
+    {
+      depth = atoi(argv[i + 1]);
+      ok = depth >= 0 && depth <= MAX_DEPTH;
+    }
+    else if (!strcmp(argv[i], "-time"))
+    {
+      ms = atoi(argv[i + 1]);
+      ok = ms >= 0;
+    }
+    else if (!strcmp(argv[i], "-threads"))
+    {
+      threads = atoi(argv[i + 1]);
+    }
+    else if (!strcmp(argv[i], "-hash"))
+    {
+      hashMB = atoi(argv[i + 1]);
+    }
+    else if (!strcmp(argv[i], "-format"))
+    {
+      csv = !strcmp(argv[i + 1], "csv");
+      ok = csv || !strcmp(argv[i + 1], "json");
+    }
+    else
+    {
+      ok = false;
+    }
+  }
+  if (!ok)
+  {
+    fprintf(stderr, "usage: %s [-depth N] [-time MS] [-threads N] "
+                    "[-hash MB] [-format json|csv]\n", argv[0]);
+    return 1;
+  }
+
+  Evaluator eval;
+  eval.load(DEFAULT_WEIGHTS_FILE);
+  ProbCut probcut;
+  probcut.load(DEFAULT_PROBCUT_FILE);
+  TranspositionTable tt(hashMB);
+  int count = sizeof(POSITIONS) / sizeof(POSITIONS[0]);
+  vector<BenchResult> fixedDepth;
+  vector<BenchResult> fixedTime;
+  for (int i = 0; depth > 0 && i < count; i++)
+  {
+    Board board;
+    Side side;
+    parsePosition(POSITIONS[i], &board, &side);
+    tt.clear();
+    fixedDepth.push_back(runPosition(board, side, depth, nullptr, &tt, &eval,
+                                     &probcut, threads));
+  }
+  for (int i = 0; ms > 0 && i < count; i++)
+  {
+    Board board;
+    Side side;
+    parsePosition(POSITIONS[i], &board, &side);
+    tt.clear();
+    // a fixed budget for this one move, rather than a share of a clock
+    TimeManager timer;
+    timer.start(ms, board.countEmpty());
+    timer.softLimitMs = ms / 2;
+    timer.hardLimitMs = ms;
+    fixedTime.push_back(runPosition(board, side, 0, &timer, &tt, &eval,
+                                    &probcut, threads));
+  }
+
+  if (csv)
+  {
+    printf("pass,position,empties,depth,nodes,ms,nps,move,score\n");
+    printCSVPass("depth", fixedDepth);
+    printCSVPass("time", fixedTime);
+    printf("signature,%016llx,,,,,,,\n",
+           (unsigned long long) signature(fixedDepth));
+  }
+  else
+  {
+    printf("{\n  \"depth\": %d, \"time_ms\": %d, \"threads\": %d, "
+           "\"hash_mb\": %d,\n", depth, ms, threads, hashMB);
+    printf("  \"signature\": \"%016llx\",\n",
+           (unsigned long long) signature(fixedDepth));
+    printJSONPass("fixed_depth", fixedDepth, false);
+    printJSONPass("fixed_time", fixedTime, true);
+    printf("}\n");
+  }
+  return 0;
+}
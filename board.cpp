@@ -1,105 +1,296 @@
 #include "board.hpp"
-#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_AVX2_KERNELS
+#include <immintrin.h>
+#endif
 
 /*
  * Make a standard 8x8 othello board and initialize it to the standard setup.
  */
 Board::Board() {
-    taken.set(3 + 8 * 3);
-    taken.set(3 + 8 * 4);
-    taken.set(4 + 8 * 3);
-    taken.set(4 + 8 * 4);
-    black.set(4 + 8 * 3);
-    black.set(3 + 8 * 4);
+    taken = (1ULL << (3 + 8 * 3)) | (1ULL << (3 + 8 * 4))
+          | (1ULL << (4 + 8 * 3)) | (1ULL << (4 + 8 * 4));
+    black = (1ULL << (4 + 8 * 3)) | (1ULL << (3 + 8 * 4));
+    key = computeKey();
+}
+
+bool Board::onBoard(int x, int y) const {
+    return(0 <= x && x < 8 && 0 <= y && y < 8);
 }
 
+static inline bool bitAt(uint64_t b, int i) {
+    return (b >> i) & 1;
+}
+
+/*
+ * Zobrist keys: one random word per (colour, square), indexed by Side, plus
+ * one that is mixed in when black is to move. The words come from a fixed
+ * splitmix64 sequence so that keys are the same in every build and process.
+ */
+static struct ZobristTable {
+    uint64_t keys[2][64];
+    uint64_t blackToMove;
+
+    ZobristTable() {
+        uint64_t state = 0x4f74656c6c6f2121ULL;
+        for (int i = 0; i < 129; i++) {
+            uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            z ^= z >> 31;
+            if (i < 128) keys[i / 64][i % 64] = z;
+            else blackToMove = z;
+        }
+    }
+} ZOBRIST;
+
 /*
- * Destructor for the board.
+ * Computes the Zobrist key of the discs from scratch.
  */
-Board::~Board() {
+uint64_t Board::computeKey() const {
+    uint64_t k = 0;
+    for (int i = 0; i < 64; i++) {
+        if (bitAt(black, i)) k ^= ZOBRIST.keys[BLACK][i];
+        else if (bitAt(taken, i)) k ^= ZOBRIST.keys[WHITE][i];
+    }
+    return k;
 }
 
 /*
- * Returns a copy of this board.
+ * Returns the Zobrist hash of this position with the given side to move.
  */
-Board *Board::copy() {
-    Board *newBoard = new Board();
-    newBoard->black = black;
-    newBoard->taken = taken;
-    return newBoard;
+uint64_t Board::getKey(Side toMove) const {
+    return (toMove == BLACK) ? (key ^ ZOBRIST.blackToMove) : key;
 }
 
-bool Board::occupied(int x, int y) {
-    return taken[x + 8*y];
+/*
+ * Masks that stop a shifted bitboard from wrapping around between columns.
+ * Square (x, y) lives in bit x + 8*y, so shifting left by 1 moves east.
+ */
+static const uint64_t NOT_COL_0 = 0xfefefefefefefefeULL;
+static const uint64_t NOT_COL_7 = 0x7f7f7f7f7f7f7f7fULL;
+static const uint64_t INNER_COLS = NOT_COL_0 & NOT_COL_7;
+
+static inline uint64_t shiftBits(uint64_t b, int s) {
+    return (s > 0) ? (b << s) : (b >> -s);
 }
 
-bool Board::get(Side side, int x, int y) {
-    return occupied(x, y) && (black[x + 8*y] == (side == BLACK));
+/*
+ * The eight compass directions as a bit shift plus the mask an opponent run
+ * must lie inside so that the run cannot wrap around the board edge.
+ */
+static const int DIR_SHIFTS[8] = { 1, -1, 8, -8, 9, -9, 7, -7 };
+static const uint64_t DIR_MASKS[8] = {
+    INNER_COLS, INNER_COLS, ~0ULL, ~0ULL,
+    INNER_COLS, INNER_COLS, INNER_COLS, INNER_COLS
+};
+
+/*
+ * Returns every legal move for a side to play with discs "own" against
+ * discs "opp", as a bitboard. Each direction is handled with a Kogge-Stone
+ * fill: own discs are propagated through runs of opponent discs in three
+ * doubling steps, and the empty square just past a run is a legal move.
+ */
+static uint64_t movesScalar(uint64_t own, uint64_t opp) {
+    uint64_t empty = ~(own | opp);
+    uint64_t moves = 0;
+    for (int d = 0; d < 8; d++) {
+        int s = DIR_SHIFTS[d];
+        uint64_t gen = own;
+        uint64_t pro = opp & DIR_MASKS[d];
+        gen |= pro & shiftBits(gen, s);
+        pro &= shiftBits(pro, s);
+        gen |= pro & shiftBits(gen, 2 * s);
+        pro &= shiftBits(pro, 2 * s);
+        gen |= pro & shiftBits(gen, 4 * s);
+        moves |= shiftBits(gen & ~own, s) & empty;
+    }
+    return moves;
 }
 
-void Board::set(Side side, int x, int y) {
-    taken.set(x + 8*y);
-    black.set(x + 8*y, side == BLACK);
+#ifdef HAVE_AVX2_KERNELS
+/*
+ * The same fill as movesScalar with four directions to a register: one
+ * 64-bit lane each for east, south, south-east and south-west, shifted
+ * left, and then the same four lanes shifted right for the opposite
+ * directions. Compiled for AVX2 whatever the build flags, so it must only
+ * be called when the CPU has AVX2.
+ */
+__attribute__((target("avx2")))
+static uint64_t movesAVX2(uint64_t own, uint64_t opp) {
+    const __m256i shift1 = _mm256_set_epi64x(7, 9, 8, 1);
+    const __m256i shift2 = _mm256_add_epi64(shift1, shift1);
+    const __m256i shift4 = _mm256_add_epi64(shift2, shift2);
+    const __m256i masks = _mm256_set_epi64x(INNER_COLS, INNER_COLS, ~0ULL,
+                                            INNER_COLS);
+    __m256i p = _mm256_set1_epi64x(own);
+    __m256i pro = _mm256_and_si256(_mm256_set1_epi64x(opp), masks);
+
+    __m256i gen = _mm256_or_si256(p, _mm256_and_si256(pro,
+        _mm256_sllv_epi64(p, shift1)));
+    __m256i proL = _mm256_and_si256(pro, _mm256_sllv_epi64(pro, shift1));
+    gen = _mm256_or_si256(gen, _mm256_and_si256(proL,
+        _mm256_sllv_epi64(gen, shift2)));
+    proL = _mm256_and_si256(proL, _mm256_sllv_epi64(proL, shift2));
+    gen = _mm256_or_si256(gen, _mm256_and_si256(proL,
+        _mm256_sllv_epi64(gen, shift4)));
+    __m256i moves = _mm256_sllv_epi64(_mm256_andnot_si256(p, gen), shift1);
+
+    gen = _mm256_or_si256(p, _mm256_and_si256(pro,
+        _mm256_srlv_epi64(p, shift1)));
+    __m256i proR = _mm256_and_si256(pro, _mm256_srlv_epi64(pro, shift1));
+    gen = _mm256_or_si256(gen, _mm256_and_si256(proR,
+        _mm256_srlv_epi64(gen, shift2)));
+    proR = _mm256_and_si256(proR, _mm256_srlv_epi64(proR, shift2));
+    gen = _mm256_or_si256(gen, _mm256_and_si256(proR,
+        _mm256_srlv_epi64(gen, shift4)));
+    moves = _mm256_or_si256(moves,
+        _mm256_srlv_epi64(_mm256_andnot_si256(p, gen), shift1));
+
+    __m128i half = _mm_or_si128(_mm256_castsi256_si128(moves),
+                                _mm256_extracti128_si256(moves, 1));
+    half = _mm_or_si128(half, _mm_unpackhi_epi64(half, half));
+    return (uint64_t) _mm_cvtsi128_si64(half) & ~(own | opp);
 }
 
-bool Board::onBoard(int x, int y) {
-    return(0 <= x && x < 8 && 0 <= y && y < 8);
+static bool cpuHasAVX2() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+#else
+static uint64_t movesAVX2(uint64_t own, uint64_t opp) {
+    return movesScalar(own, opp);
+}
+
+static bool cpuHasAVX2() {
+    return false;
+}
+#endif
+
+/*
+ * The kernel legalMoves uses, chosen once at startup. A plain flag rather
+ * than a function pointer, so that the branch predicts perfectly and the
+ * scalar kernel can still be inlined.
+ */
+static bool useAVX2 = cpuHasAVX2();
+
+bool setMoveKernel(MoveKernel kernel) {
+    if (kernel == KERNEL_AVX2 && !cpuHasAVX2()) return false;
+    useAVX2 = (kernel == KERNEL_AUTO) ? cpuHasAVX2() : kernel == KERNEL_AVX2;
+    return true;
+}
+
+const char *moveKernelName() {
+    return useAVX2 ? "avx2" : "scalar";
 }
 
+static inline uint64_t movesFor(uint64_t own, uint64_t opp) {
+    return useAVX2 ? movesAVX2(own, opp) : movesScalar(own, opp);
+}
 
 /*
  * Returns true if the game is finished; false otherwise. The game is finished
  * if neither side has a legal move.
  */
-bool Board::isDone() {
-    return !(hasMoves(BLACK) || hasMoves(WHITE));
+bool Board::isDone() const {
+    return (legalMoves(BLACK) | legalMoves(WHITE)) == 0;
+}
+
+/*
+ * Returns a bitboard of all legal moves for the given side, with the move
+ * (x, y) in bit x + 8*y.
+ */
+uint64_t Board::legalMoves(Side side) const {
+    uint64_t b = black;
+    uint64_t w = taken & ~b;
+    return (side == BLACK) ? movesFor(b, w) : movesFor(w, b);
+}
+
+/*
+ * Returns the number of legal moves for the given side.
+ */
+int Board::mobility(Side side) const {
+    return __builtin_popcountll(legalMoves(side));
 }
 
 /*
  * Returns true if there are legal moves for the given side.
  */
-bool Board::hasMoves(Side side) {
-    for (int i = 0; i < 8; i++) {
-        for (int j = 0; j < 8; j++) {
-            Move move(i, j);
-            if (checkMove(&move, side)) return true;
-        }
-    }
-    return false;
+bool Board::hasMoves(Side side) const {
+    return legalMoves(side) != 0;
 }
 
 /*
  * Returns true if a move is legal for the given side; false otherwise.
+ * A Move always names a square on the board, so coordinates read from
+ * outside have to be checked with onBoard before a Move is made of them.
  */
-bool Board::checkMove(Move *m, Side side) {
+bool Board::checkMove(Move *m, Side side) const {
     // Passing is only legal if you have no moves.
     if (m == nullptr) return !hasMoves(side);
 
-    int X = m->getX();
-    int Y = m->getY();
+    return (legalMoves(side) >> m->square) & 1;
+}
 
-    // Make sure the square hasn't already been taken.
-    if (occupied(X, Y)) return false;
+/*
+ * Returns the opponent discs flipped when the side with discs "own" plays
+ * on "square". The same directional fill as movesFor is run outwards from
+ * the move; a run of opponent discs is kept only if the square past it is
+ * one of our own, which is selected with a mask rather than a branch.
+ */
+static uint64_t flipsFor(uint64_t own, uint64_t opp, int square) {
+    uint64_t move = 1ULL << square;
+    uint64_t flips = 0;
+    for (int d = 0; d < 8; d++) {
+        int s = DIR_SHIFTS[d];
+        uint64_t gen = move;
+        uint64_t pro = opp & DIR_MASKS[d];
+        gen |= pro & shiftBits(gen, s);
+        pro &= shiftBits(pro, s);
+        gen |= pro & shiftBits(gen, 2 * s);
+        pro &= shiftBits(pro, 2 * s);
+        gen |= pro & shiftBits(gen, 4 * s);
+        uint64_t capped = (shiftBits(gen, s) & own) != 0;
+        flips |= (gen & ~move) & (0 - capped);
+    }
+    return flips;
+}
 
-    Side other = (side == BLACK) ? WHITE : BLACK;
-    for (int dx = -1; dx <= 1; dx++) {
-        for (int dy = -1; dy <= 1; dy++) {
-            if (dy == 0 && dx == 0) continue;
+/*
+ * Returns the discs that would be flipped if the given side played on
+ * square (x + 8*y). The result is meaningless for an illegal move.
+ */
+uint64_t Board::getFlips(int square, Side side) const {
+    uint64_t b = black;
+    uint64_t w = taken & ~b;
+    return (side == BLACK) ? flipsFor(b, w, square) : flipsFor(w, b, square);
+}
 
-            // Is there a capture in that direction?
-            int x = X + dx;
-            int y = Y + dy;
-            if (onBoard(x, y) && get(other, x, y)) {
-                do {
-                    x += dx;
-                    y += dy;
-                } while (onBoard(x, y) && get(other, x, y));
+/*
+ * Plays a move that is already known to be legal, e.g. one taken from
+ * legalMoves(). Every flipped disc changes colour, so the whole update is
+ * one XOR into each word. The Zobrist key swaps the colour of each flipped
+ * disc and adds the new one.
+ */
+void Board::makeMove(int square, Side side) {
+    makeMove(square, side, getFlips(square, side));
+}
 
-                if (onBoard(x, y) && get(side, x, y)) return true;
-            }
-        }
+/*
+ * Same as makeMove(square, side), for callers that already computed the
+ * flips, e.g. to test whether the move was legal.
+ */
+void Board::makeMove(int square, Side side, uint64_t flips) {
+    uint64_t move = 1ULL << square;
+    taken ^= move;
+    black ^= (side == BLACK) ? (flips | move) : flips;
+    key ^= ZOBRIST.keys[side][square];
+    while (flips) {
+        int i = __builtin_ctzll(flips);
+        flips &= flips - 1;
+        key ^= ZOBRIST.keys[WHITE][i] ^ ZOBRIST.keys[BLACK][i];
     }
-    return false;
 }
 
 /*
@@ -112,55 +303,49 @@ void Board::doMove(Move *m, Side side) {
     // Ignore if move is invalid.
     if (!checkMove(m, side)) return;
 
-    int X = m->getX();
-    int Y = m->getY();
-    Side other = (side == BLACK) ? WHITE : BLACK;
-    for (int dx = -1; dx <= 1; dx++) {
-        for (int dy = -1; dy <= 1; dy++) {
-            if (dy == 0 && dx == 0) continue;
-
-            int x = X;
-            int y = Y;
-            do {
-                x += dx;
-                y += dy;
-            } while (onBoard(x, y) && get(other, x, y));
-
-            if (onBoard(x, y) && get(side, x, y)) {
-                x = X;
-                y = Y;
-                x += dx;
-                y += dy;
-                while (onBoard(x, y) && get(other, x, y)) {
-                    set(side, x, y);
-                    x += dx;
-                    y += dy;
-                }
-            }
-        }
-    }
-    set(side, X, Y);
+    makeMove(m->getX() + 8 * m->getY(), side);
 }
 
 /*
  * Current count of given side's stones.
  */
-int Board::count(Side side) {
+int Board::count(Side side) const {
     return (side == BLACK) ? countBlack() : countWhite();
 }
 
 /*
  * Current count of black stones.
  */
-int Board::countBlack() {
-    return black.count();
+int Board::countBlack() const {
+    return __builtin_popcountll(black);
 }
 
 /*
  * Current count of white stones.
  */
-int Board::countWhite() {
-    return taken.count() - black.count();
+int Board::countWhite() const {
+    return __builtin_popcountll(taken & ~black);
+}
+
+/*
+ * Current count of empty squares.
+ */
+int Board::countEmpty() const {
+    return 64 - __builtin_popcountll(taken);
+}
+
+/*
+ * Bitboard of the empty squares.
+ */
+uint64_t Board::emptySquares() const {
+    return ~taken;
+}
+
+/*
+ * Bitboard of the given side's discs.
+ */
+uint64_t Board::discs(Side side) const {
+    return (side == BLACK) ? black : (taken & ~black);
 }
 
 /*
@@ -168,19 +353,20 @@ int Board::countWhite() {
  * piece and 'b' indicates a black piece. Mainly for testing purposes.
  */
 void Board::setBoard(char data[]) {
-    taken.reset();
-    black.reset();
+    taken = 0;
+    black = 0;
     for (int i = 0; i < 64; i++) {
         if (data[i] == 'b') {
-            taken.set(i);
-            black.set(i);
+            taken |= 1ULL << i;
+            black |= 1ULL << i;
         } if (data[i] == 'w') {
-            taken.set(i);
+            taken |= 1ULL << i;
         }
     }
+    key = computeKey();
 }
 // this function gets the current value of the board from white's perspective
-int Board::getWhiteValue()
+int Board::getWhiteValue() const
 {
   int cornerValue = 5; // deny corners!
   int edgeValue = 3;
@@ -193,12 +379,12 @@ int Board::getWhiteValue()
   {
     for (int j = 1; j < 7; j++) 
     {
-      if (black[i+8*j])
+      if (bitAt(black, i+8*j))
         // then the location has a black piece
       {
         blackTotal += normalValue;
       }
-      else if (taken[i+8*j])
+      else if (bitAt(taken, i+8*j))
       {
         // then the location has a white piece
         whiteTotal += normalValue;
@@ -209,122 +395,211 @@ int Board::getWhiteValue()
   for (int i = 1; i < 7; i++)
   { 
     // check top edge
-    if (black[i]) {blackTotal += edgeValue;}
-    else if (taken[i]) {whiteTotal += edgeValue;}
+    if (bitAt(black, i)) {blackTotal += edgeValue;}
+    else if (bitAt(taken, i)) {whiteTotal += edgeValue;}
   
     // check left edge
-    if (black[8*i]) {blackTotal += edgeValue;}
-    else if (taken[8*i]) {whiteTotal += edgeValue;}
+    if (bitAt(black, 8*i)) {blackTotal += edgeValue;}
+    else if (bitAt(taken, 8*i)) {whiteTotal += edgeValue;}
   
     // check bottom edge
-    if (black[i+7*8]) {blackTotal += edgeValue;}
-    else if (taken[i+7*8]) {whiteTotal += edgeValue;}
+    if (bitAt(black, i+7*8)) {blackTotal += edgeValue;}
+    else if (bitAt(taken, i+7*8)) {whiteTotal += edgeValue;}
 
     // check right edge
-    if (black[7+8*i]) {blackTotal += edgeValue;}
-    else if (taken[7+8*i]) {whiteTotal += edgeValue;}
+    if (bitAt(black, 7+8*i)) {blackTotal += edgeValue;}
+    else if (bitAt(taken, 7+8*i)) {whiteTotal += edgeValue;}
   }
   // now check corner locations
-  if (black[0]) {blackTotal += cornerValue;}
-  else if (taken[0]) {whiteTotal += cornerValue;}
+  if (bitAt(black, 0)) {blackTotal += cornerValue;}
+  else if (bitAt(taken, 0)) {whiteTotal += cornerValue;}
   
-  if (black[7]) {blackTotal += cornerValue;}
-  else if (taken[7]) {whiteTotal += cornerValue;}
+  if (bitAt(black, 7)) {blackTotal += cornerValue;}
+  else if (bitAt(taken, 7)) {whiteTotal += cornerValue;}
  
-  if (black[56]) {blackTotal += cornerValue;}
-  else if (taken[56]) {whiteTotal += cornerValue;}
+  if (bitAt(black, 56)) {blackTotal += cornerValue;}
+  else if (bitAt(taken, 56)) {whiteTotal += cornerValue;}
 
-  if (black[63]) {blackTotal += cornerValue;}
-  else if (taken[63]) {whiteTotal += cornerValue;}
+  if (bitAt(black, 63)) {blackTotal += cornerValue;}
+  else if (bitAt(taken, 63)) {whiteTotal += cornerValue;}
 
   // check for stability and award additional points
-  bitset<64> stable = getStableArray();
-  if (stable.count() != 0)
-  {
-    // then there are stable positions
-    for (int i = 0; i < 64; i++)
-    {
-      if (stable[i])
-      {
-        if (black[i]) {blackTotal += stableValue;}
-        else if (taken[i]) {whiteTotal += stableValue;}
-      }
-    }
-  }
+  blackTotal += stableValue * __builtin_popcountll(stableDiscs(BLACK));
+  whiteTotal += stableValue * __builtin_popcountll(stableDiscs(WHITE));
 
   return (whiteTotal - blackTotal);
 }
 
-bool Board::isYFull(int x)
-{ // checks if the vertical is full at position x
-  bool full = true;
-  for (int y = 0; y < 8; y++)
-  {
-    if (!taken[x+8*y]) {full = false;}
-  }
-  return full;
-}
+// tables for the stability computation, built once at startup
+static struct StabilityTables {
+  // stable discs (of either colour) on an edge, indexed by the edge read as
+  // a base-3 number: digit i is square i of the edge, 0 empty, 1 or 2 a disc
+  uint8_t edge[6561];
+  uint16_t ternary[256]; // bits of a byte as base-3 digits: 0 or 1 each
+  uint64_t spread[256]; // bit i of a byte moved to bit 8*i
 
-bool Board::isXFull(int y)
-{
-  bool full = true;
-  for (int x = 0; x < 8; x++)
-  {
-    if (!taken[x+8*y]) {full = false;}
-  }
-  return full;
-}
-
-bitset<64> Board::getStableArray()
-{
-// calculates whether each piece is currently stable
-  bitset<64> stable;
-  stable.reset();
-  vector<int> xFull;
-  vector<int> yFull;
-  for (int i = 0; i < 8; i++)
-  {
-    if (isYFull(i)) {yFull.push_back(i);}
-    if (isXFull(i)) {xFull.push_back(i);}
-  }
-  for (int i = 0; i < (int) xFull.size(); i++) 
+  StabilityTables()
   {
-    for (int j = 0; j < (int) yFull.size(); j++)
+    for (int b = 0; b < 256; b++)
     {
-      stable.set(i+8*j);
+      ternary[b] = 0;
+      spread[b] = 0;
+      for (int i = 7; i >= 0; i--)
+      {
+        ternary[b] = ternary[b] * 3 + ((b >> i) & 1);
+        if ((b >> i) & 1) {spread[b] |= 1ULL << (8 * i);}
+      }
     }
+    int8_t done[6561] = {0};
+    for (int e = 0; e < 6561; e++) {edgeStable(e, done);}
   }
-  // add the corner pieces
-  stable.set(0);
-  stable.set(7);
-  stable.set(56);
-  stable.set(63);
-
-  // now evaluate to check if there are any pieces surrounded by stable pieces
-  // check the central region:
-  for (int i = 1; i < 7; i++) 
+
+  // plays a disc of colour c (1 or 2) at square x of an edge and flips the
+  // bracketed discs along the edge. a move there may well be legal only
+  // through another direction, so a move without flips still places a disc
+  static void play(int cells[8], int x, int c)
   {
-    for (int j = 1; j < 7; j++)
+    cells[x] = c;
+    for (int dir = -1; dir <= 1; dir += 2)
     {
-      if (stable[(i-1)+8*(j-1)] && stable[(i-1)+8*(j+1)] 
-       && stable[(i+1)+8*(j-1)] && stable[(i+1)+8*(j+1)]
-       && taken[i+8*j])
+      int i = x + dir;
+      while (0 <= i && i < 8 && cells[i] == 3 - c) {i += dir;}
+      if (0 <= i && i < 8 && cells[i] == c)
       {
-        // if position i,j is surrounded by stable pieces, it is stable as well
-        stable.set(i+8*j);
+        for (int j = x + dir; j != i; j += dir) {cells[j] = c;}
       }
     }
   }
-  // now check the edges
-  for (int i = 1; i < 7; i++)
+
+  // the discs of an edge that keep their colour however the edge fills up.
+  // every continuation has fewer empties, so the recursion is memoized
+  uint8_t edgeStable(int e, int8_t done[])
   {
-    if (stable[i-1] && stable[i+1] && taken[i]) {stable.set(i);}
-    if (stable[56+i-1] && stable[56+i-1] && taken[56+i]) {stable.set(56+i);}
-    if (stable[8*(i-1)] && stable[8*(i+1)] && taken[8*i]) {stable.set(8*i);}
-    if (stable[7+8*(i-1)] && stable[7+8*(i+1)] && taken[7+8*i])
+    if (done[e]) {return edge[e];}
+    int cells[8];
+    int rest = e;
+    uint8_t stable = 0;
+    for (int i = 0; i < 8; i++)
+    {
+      cells[i] = rest % 3;
+      rest /= 3;
+      if (cells[i] != 0) {stable |= 1 << i;}
+    }
+    for (int x = 0; x < 8 && stable != 0; x++)
     {
-      stable.set(7+8*i);
+      if (cells[x] != 0) {continue;}
+      for (int c = 1; c <= 2; c++)
+      {
+        int next[8];
+        for (int i = 0; i < 8; i++) {next[i] = cells[i];}
+        play(next, x, c);
+        int n = 0;
+        for (int i = 7; i >= 0; i--) {n = n * 3 + next[i];}
+        uint8_t kept = edgeStable(n, done);
+        // a disc stays stable only if it is stable, with the same colour,
+        // after every possible move
+        for (int i = 0; i < 8; i++)
+        {
+          if (next[i] != cells[i]) {kept &= ~(1 << i);}
+        }
+        stable &= kept;
+      }
     }
+    edge[e] = stable;
+    done[e] = 1;
+    return stable;
   }
+} STABILITY;
+
+// extracts column x as a byte, with row i in bit i
+static inline int columnByte(uint64_t b, int x)
+{
+  return (int) ((((b >> x) & 0x0101010101010101ULL)
+                 * 0x0102040810204080ULL) >> 56);
+}
+
+// looks up the stable discs of one edge given its own and opponent bytes
+static inline int edgeStable(int own, int opp)
+{
+  return STABILITY.edge[STABILITY.ternary[own] + 2 * STABILITY.ternary[opp]];
+}
+
+// spreads every set bit along one direction as far as the board goes, with
+// the same doubling steps as movesFor. mask excludes the column a shift in
+// this direction would wrap around into
+static inline uint64_t smear(uint64_t b, int s, uint64_t mask)
+{
+  uint64_t pro = mask;
+  b |= pro & shiftBits(b, s);
+  pro &= shiftBits(pro, s);
+  b |= pro & shiftBits(b, 2 * s);
+  pro &= shiftBits(pro, 2 * s);
+  b |= pro & shiftBits(b, 4 * s);
+  return b;
+}
+
+/*
+ * Returns the discs on the four edges that can never be flipped again,
+ * whatever their colour. A disc on an edge can only be flipped along that
+ * edge, so this is exact for them, and cheap: one table lookup per edge.
+ */
+uint64_t Board::stableEdges() const
+{
+  uint64_t white = taken & ~black;
+  return (uint64_t) edgeStable(black & 0xff, white & 0xff)
+       | (uint64_t) edgeStable(black >> 56, white >> 56) << 56
+       | STABILITY.spread[edgeStable(columnByte(black, 0),
+                                     columnByte(white, 0))]
+       | STABILITY.spread[edgeStable(columnByte(black, 7),
+                                     columnByte(white, 7))] << 7;
+}
+
+/*
+ * Returns the discs of the given side that can never be flipped again.
+ * Edge discs come from the precomputed edge table. Any other disc is stable
+ * once, in each of the four line directions, its line is full or it has a
+ * stable disc of its own colour (or the board edge) on one side. That rule
+ * is applied repeatedly until no more discs are added.
+ */
+uint64_t Board::stableDiscs(Side side) const
+{
+  uint64_t own = discs(side);
+  if (own == 0) {return 0;}
+
+  // squares whose whole line in each direction is filled. a row is full if
+  // the AND of its byte's bits is set, and a column if the AND of the rows
+  // is. for the diagonals the empties are smeared along the line both ways
+  uint64_t full[4];
+  uint64_t t = taken & (taken >> 4);
+  t &= t >> 2;
+  t &= t >> 1;
+  full[0] = (t & 0x0101010101010101ULL) * 0xff;
+  t = taken & (taken >> 32);
+  t &= t >> 16;
+  t &= t >> 8;
+  full[1] = (t & 0xff) * 0x0101010101010101ULL;
+  uint64_t empty = ~taken;
+  full[2] = ~(smear(empty, 9, NOT_COL_0) | smear(empty, -9, NOT_COL_7));
+  full[3] = ~(smear(empty, 7, NOT_COL_7) | smear(empty, -7, NOT_COL_0));
+
+  uint64_t stable = stableEdges() & own;
+  stable |= own & full[0] & full[1] & full[2] & full[3];
+
+  const uint64_t ROW_EDGES = 0xff000000000000ffULL;
+  const uint64_t COL_EDGES = 0x8181818181818181ULL;
+  uint64_t interior = own & ~(ROW_EDGES | COL_EDGES);
+  uint64_t previous;
+  do
+  {
+    previous = stable;
+    uint64_t h = full[0] | ((stable << 1) & NOT_COL_0)
+               | ((stable >> 1) & NOT_COL_7);
+    uint64_t v = full[1] | (stable << 8) | (stable >> 8);
+    uint64_t d = full[2] | ((stable << 9) & NOT_COL_0)
+               | ((stable >> 9) & NOT_COL_7);
+    uint64_t a = full[3] | ((stable << 7) & NOT_COL_7)
+               | ((stable >> 7) & NOT_COL_0);
+    stable |= interior & h & v & d & a;
+  } while (stable != previous);
   return stable;
 }
@@ -1,42 +1,66 @@
 #ifndef __BOARD_H__
 #define __BOARD_H__
 
-#include <bitset>
+#include <cstdint>
+#include <type_traits>
 #include "common.hpp"
 using namespace std;
 
+// The board is a plain value: one word of occupied squares and one word of
+// black discs, with square (x, y) in bit x + 8*y, plus a Zobrist key of the
+// discs that makeMove keeps up to date. It is meant to be copied freely on
+// the stack by the search.
 class Board {
 
 private:
-    bitset<64> black;
-    bitset<64> taken;
-
-    bool occupied(int x, int y);
-    bool get(Side side, int x, int y);
-    void set(Side side, int x, int y);
-    bool onBoard(int x, int y);
-    bitset<64> getStableArray(); // checks if pieces are stable just by looking
-                                 // at filled rows and columns
-    bool isYFull(int x); 
-    bool isXFull(int y);
+    uint64_t black;
+    uint64_t taken;
+    uint64_t key;
+
+    bool onBoard(int x, int y) const;
+    uint64_t computeKey() const;
 public:
     Board();
-    ~Board();
-    Board *copy();
 
-    bool isDone();
-    bool hasMoves(Side side);
-    bool checkMove(Move *m, Side side);
+    bool isDone() const;
+    uint64_t legalMoves(Side side) const; // bit (x + 8*y) set for legal moves
+    bool hasMoves(Side side) const;
+    int mobility(Side side) const; // number of legal moves
+    bool checkMove(Move *m, Side side) const;
     void doMove(Move *m, Side side);
-    int count(Side side);
-    int countBlack();
-    int countWhite();
+    uint64_t getFlips(int square, Side side) const; // discs flipped by a move
+    void makeMove(int square, Side side); // unchecked; square must be legal
+    void makeMove(int square, Side side, uint64_t flips); // flips must come
+                                                          // from getFlips
+    int count(Side side) const;
+    int countBlack() const;
+    int countWhite() const;
+    int countEmpty() const;
+    uint64_t emptySquares() const;
+    uint64_t discs(Side side) const; // bitboard of the side's discs
+    uint64_t stableDiscs(Side side) const; // discs that can never flip
+    uint64_t stableEdges() const; // edge discs of either colour that can
+                                  // never flip, from the edge table alone
+
+    uint64_t getKey(Side toMove) const; // Zobrist hash of the position
 
     void setBoard(char data[]);
-    int getWhiteValue(); // this function gets the current value of the board
-                         // from white's perspective. this considers edge
-                         // and corners to be more valuable than intermediate
-                         // pieces
+    int getWhiteValue() const; // this function gets the current value of the
+                               // board from white's perspective. this
+                               // considers edge and corners to be more
+                               // valuable than intermediate pieces
 };
 
+// which kernel legalMoves uses: AUTO picks the AVX2 one when the CPU has
+// AVX2, and the scalar one otherwise; the benchmarks can force either.
+// setMoveKernel returns false, and changes nothing, if the CPU cannot run
+// the kernel asked for
+enum MoveKernel { KERNEL_AUTO, KERNEL_SCALAR, KERNEL_AVX2 };
+bool setMoveKernel(MoveKernel kernel);
+const char *moveKernelName();
+
+static_assert(sizeof(Board) == 24, "Board should be three 64-bit words");
+static_assert(is_trivially_copyable<Board>::value,
+              "Board should be copyable with memcpy");
+
 #endif
@@ -0,0 +1,211 @@
+// Memory-mapped opening book for the Othello AI
+
+#include "book.hpp"
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+using namespace std;
+
+static_assert(sizeof(BookEntry) == 24, "file layout");
+
+struct BookHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t count;
+};
+
+// the symmetries are numbered as in the evaluator: bit 0 mirrors x, bit 1
+// mirrors y, and bit 2 then swaps x and y
+
+static inline uint64_t mirrorX(uint64_t b)
+{
+  b = ((b >> 1) & 0x5555555555555555ULL) | ((b & 0x5555555555555555ULL) << 1);
+  b = ((b >> 2) & 0x3333333333333333ULL) | ((b & 0x3333333333333333ULL) << 2);
+  b = ((b >> 4) & 0x0f0f0f0f0f0f0f0fULL) | ((b & 0x0f0f0f0f0f0f0f0fULL) << 4);
+  return b;
+}
+
+static inline uint64_t mirrorY(uint64_t b)
+{
+  return __builtin_bswap64(b);
+}
+
+static inline uint64_t swapXY(uint64_t b)
+{
+  uint64_t t;
+  t = 0x0f0f0f0f00000000ULL & (b ^ (b << 28));
+  b ^= t ^ (t >> 28);
+  t = 0x3333000033330000ULL & (b ^ (b << 14));
+  b ^= t ^ (t >> 14);
+  t = 0x5500550055005500ULL & (b ^ (b << 7));
+  b ^= t ^ (t >> 7);
+  return b;
+}
+
+static inline uint64_t transform(uint64_t b, int symmetry)
+{
+  if (symmetry & 1) {b = mirrorX(b);}
+  if (symmetry & 2) {b = mirrorY(b);}
+  if (symmetry & 4) {b = swapXY(b);}
+  return b;
+}
+
+static inline bool keyLess(uint64_t own1, uint64_t opp1, uint64_t own2,
+                           uint64_t opp2)
+{
+  return own1 < own2 || (own1 == own2 && opp1 < opp2);
+}
+
+OpeningBook::OpeningBook()
+{
+  mapping = nullptr;
+  mappingSize = 0;
+  table = nullptr;
+  count = 0;
+}
+
+OpeningBook::~OpeningBook()
+{
+  close();
+}
+
+bool OpeningBook::open(const char *path)
+{
+  close();
+  int fd = ::open(path, O_RDONLY);
+  if (fd < 0)
+  {
+    return false;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof(BookHeader))
+  {
+    ::close(fd);
+    return false;
+  }
+  size_t size = info.st_size;
+  void *data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  // the mapping stays valid after the descriptor is closed
+  ::close(fd);
+  if (data == MAP_FAILED)
+  {
+    return false;
+  }
+  const BookHeader *header = (const BookHeader *) data;
+  if (memcmp(header->magic, "OTHB", 4) != 0
+   || header->version != BOOK_FILE_VERSION
+   || header->count != (size - sizeof(BookHeader)) / sizeof(BookEntry)
+   || (size - sizeof(BookHeader)) % sizeof(BookEntry) != 0)
+  {
+    munmap(data, size);
+    return false;
+  }
+  mapping = data;
+  mappingSize = size;
+  table = (const BookEntry *) (header + 1);
+  count = header->count;
+  return true;
+}
+
+void OpeningBook::close()
+{
+  if (mapping != nullptr)
+  {
+    munmap(mapping, mappingSize);
+  }
+  mapping = nullptr;
+  mappingSize = 0;
+  table = nullptr;
+  count = 0;
+}
+
+int OpeningBook::canonical(const Board &board, Side side, uint64_t *own,
+                           uint64_t *opp)
+{
+  uint64_t mine = board.discs(side);
+  uint64_t theirs = board.discs(flip(side));
+  int best = 0;
+  *own = mine;
+  *opp = theirs;
+  for (int s = 1; s < 8; s++)
+  {
+    uint64_t a = transform(mine, s);
+    uint64_t b = transform(theirs, s);
+    if (keyLess(a, b, *own, *opp))
+    {
+      *own = a;
+      *opp = b;
+      best = s;
+    }
+  }
+  return best;
+}
+
+int OpeningBook::transformSquare(int square, int symmetry)
+{
+  int x = square & 7;
+  int y = square >> 3;
+  if (symmetry & 1) {x = 7 - x;}
+  if (symmetry & 2) {y = 7 - y;}
+  if (symmetry & 4) {int t = x; x = y; y = t;}
+  return x + 8 * y;
+}
+
+int OpeningBook::untransformSquare(int square, int symmetry)
+{
+  int x = square & 7;
+  int y = square >> 3;
+  if (symmetry & 4) {int t = x; x = y; y = t;}
+  if (symmetry & 2) {y = 7 - y;}
+  if (symmetry & 1) {x = 7 - x;}
+  return x + 8 * y;
+}
+
+bool OpeningBook::probe(const Board &board, Side side, Move *move,
+                        int *score) const
+{
+  if (count == 0)
+  {
+    return false;
+  }
+  uint64_t own, opp;
+  int symmetry = canonical(board, side, &own, &opp);
+  // binary search for the first entry not less than the key
+  size_t low = 0;
+  size_t high = count;
+  while (low < high)
+  {
+    size_t middle = low + (high - low) / 2;
+    if (keyLess(table[middle].own, table[middle].opp, own, opp))
+    {
+      low = middle + 1;
+    }
+    else
+    {
+      high = middle;
+    }
+  }
+  if (low == count || table[low].own != own || table[low].opp != opp)
+  {
+    return false;
+  }
+  // a damaged entry, off the board or not legal here, is left to the
+  // search
+  if (table[low].move >= 64)
+  {
+    return false;
+  }
+  int square = untransformSquare(table[low].move, symmetry);
+  if (!((board.legalMoves(side) >> square) & 1))
+  {
+    return false;
+  }
+  move->square = square;
+  if (score != nullptr)
+  {
+    *score = table[low].score;
+  }
+  return true;
+}
@@ -0,0 +1,72 @@
+#ifndef __BOOK_H__
+#define __BOOK_H__
+
+#include <cstdint>
+#include <cstddef>
+#include "common.hpp"
+#include "board.hpp"
+
+// Opening book. Every entry is a position with the side to move's best move
+// and its score. Positions are keyed by the 128 bits of the two bitboards,
+// the mover's discs and the opponent's, so there are no collisions; and
+// since a position and its 7 reflections and rotations play the same, each
+// is stored once, in whichever of the 8 orientations has the smallest key.
+//
+// The file is memory-mapped read-only, so it is not copied or parsed when
+// it is opened and player processes sharing a book share its pages:
+//   char[4]    "OTHB"
+//   uint32     version (BOOK_FILE_VERSION)
+//   uint64     number of entries
+//   BookEntry  entries, sorted by (own, opp) with no duplicates
+// all little-endian.
+
+using namespace std;
+
+const uint32_t BOOK_FILE_VERSION = 1;
+const char DEFAULT_BOOK_FILE[] = "othello.book";
+
+struct BookEntry {
+  uint64_t own; // discs of the side to move
+  uint64_t opp; // discs of the other side
+  int32_t score; // in Search's units, for the side to move
+  uint8_t move; // best move, in the stored orientation
+  uint8_t depth; // depth it was searched to
+  uint16_t reserved;
+};
+
+class OpeningBook {
+public:
+  OpeningBook();
+  ~OpeningBook();
+  // maps a book file, replacing any book already open. returns false and
+  // leaves the book empty if the file is missing or invalid
+  bool open(const char *path);
+  void close();
+
+  // looks up the position. if it is in the book, stores the book move for
+  // the board as given in *move and its score in *score (if score is not
+  // nullptr) and returns true
+  bool probe(const Board &board, Side side, Move *move, int *score) const;
+
+  size_t size() const {return count;}
+  const BookEntry *entries() const {return table;}
+
+  // reduces the position to its stored orientation. returns the symmetry
+  // that maps the board onto the stored one
+  static int canonical(const Board &board, Side side, uint64_t *own,
+                       uint64_t *opp);
+  // maps a square through a symmetry, or back again
+  static int transformSquare(int square, int symmetry);
+  static int untransformSquare(int square, int symmetry);
+
+private:
+  void *mapping;
+  size_t mappingSize;
+  const BookEntry *table;
+  size_t count;
+
+  OpeningBook(const OpeningBook &);
+  OpeningBook &operator=(const OpeningBook &);
+};
+
+#endif
@@ -0,0 +1,301 @@
+// Builds the opening book for the Othello AI.
+//
+//   booktool selfplay GAMES PLIES DEPTH [FILE]
+//     plays GAMES games against itself, following the book where it can
+//     and deviating at random now and then, and adds every position of the
+//     first PLIES plies to the book
+//   booktool games RECORDS PLIES DEPTH [FILE]
+//     adds the first PLIES plies of every game in the text file RECORDS,
+//     one game per line written as its moves, e.g. "f5d6c3d3c4"
+//   booktool info [FILE]
+//     prints the number of entries and the book line from the start
+//
+// New positions, and book positions searched less deeply than DEPTH, are
+// searched full-width to DEPTH. FILE defaults to othello.book; it is
+// replaced by renaming a new file over it, so players that have the old
+// book mapped keep reading the old one.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <ctime>
+#include <map>
+#include <string>
+#include <utility>
+#include "board.hpp"
+#include "search.hpp"
+#include "eval.hpp"
+#include "book.hpp"
+using namespace std;
+
+const int RANDOM_MOVE_PERCENT = 20;
+const int TT_MB = 64;
+
+typedef pair<uint64_t, uint64_t> BookKey;
+
+// a position waiting to be searched, as it was reached
+struct Pending {
+  Board board;
+  Side side;
+};
+
+static map<BookKey, BookEntry> entries;
+static map<BookKey, Pending> pending;
+
+static void loadBook(const char *path)
+{
+  OpeningBook book;
+  if (!book.open(path))
+  {
+    return;
+  }
+  for (size_t i = 0; i < book.size(); i++)
+  {
+    const BookEntry &e = book.entries()[i];
+    entries[BookKey(e.own, e.opp)] = e;
+  }
+}
+
+// queues the position for searching unless the book already has it to
+// the given depth
+static void addPosition(const Board &board, Side side, int depth)
+{
+  if (board.legalMoves(side) == 0)
+  {
+    return;
+  }
+  BookKey key;
+  OpeningBook::canonical(board, side, &key.first, &key.second);
+  map<BookKey, BookEntry>::iterator found = entries.find(key);
+  if (found != entries.end() && found->second.depth >= depth)
+  {
+    return;
+  }
+  Pending p = {board, side};
+  pending[key] = p;
+}
+
+static void searchPending(int depth)
+{
+  Evaluator eval;
+  eval.load(DEFAULT_WEIGHTS_FILE);
+  TranspositionTable tt(TT_MB);
+  int done = 0;
+  for (map<BookKey, Pending>::iterator it = pending.begin();
+       it != pending.end(); ++it)
+  {
+    const Pending &p = it->second;
+    Search search(&tt, &eval);
+    Move best;
+    int score = search.iterativeDeepening(p.board, p.side, depth, nullptr,
+                                          &best);
+    uint64_t own, opp;
+    int symmetry = OpeningBook::canonical(p.board, p.side, &own, &opp);
+    BookEntry e;
+    memset(&e, 0, sizeof(e));
+    e.own = own;
+    e.opp = opp;
+    e.score = score;
+    e.move = OpeningBook::transformSquare(best.square, symmetry);
+    e.depth = search.completedDepth;
+    entries[it->first] = e;
+    fprintf(stderr, "\r%d/%d positions", ++done, (int) pending.size());
+  }
+  if (done > 0)
+  {
+    fprintf(stderr, "\n");
+  }
+  pending.clear();
+}
+
+static bool writeBook(const char *path)
+{
+  // std::map iterates in key order, which is the order the file needs
+  string temporary = string(path) + ".tmp";
+  FILE *file = fopen(temporary.c_str(), "wb");
+  if (file == nullptr)
+  {
+    return false;
+  }
+  uint32_t version = BOOK_FILE_VERSION;
+  uint64_t count = entries.size();
+  bool ok = fwrite("OTHB", 1, 4, file) == 4
+         && fwrite(&version, 4, 1, file) == 1
+         && fwrite(&count, 8, 1, file) == 1;
+  for (map<BookKey, BookEntry>::iterator it = entries.begin();
+       ok && it != entries.end(); ++it)
+  {
+    ok = fwrite(&it->second, sizeof(BookEntry), 1, file) == 1;
+  }
+  ok = fclose(file) == 0 && ok;
+  return ok && rename(temporary.c_str(), path) == 0;
+}
+
+// plays square for side, passing first if side cannot move. returns false
+// if the move is illegal
+static bool play(Board *board, Side *side, int square)
+{
+  if (board->legalMoves(*side) == 0)
+  {
+    *side = flip(*side);
+  }
+  if (!((board->legalMoves(*side) >> square) & 1))
+  {
+    return false;
+  }
+  board->makeMove(square, *side);
+  *side = flip(*side);
+  return true;
+}
+
+static int selfPlay(int games, int plies, int depth, const char *path)
+{
+  Evaluator eval;
+  eval.load(DEFAULT_WEIGHTS_FILE);
+  srand(time(nullptr));
+  for (int g = 0; g < games; g++)
+  {
+    Board board;
+    Side side = BLACK;
+    for (int ply = 0; ply < plies && !board.isDone(); ply++)
+    {
+      if (board.legalMoves(side) == 0)
+      {
+        side = flip(side);
+      }
+      addPosition(board, side, depth);
+      uint64_t legal = board.legalMoves(side);
+      BookKey key;
+      int symmetry = OpeningBook::canonical(board, side, &key.first,
+                                            &key.second);
+      map<BookKey, BookEntry>::iterator found = entries.find(key);
+      int square;
+      if (rand() % 100 < RANDOM_MOVE_PERCENT)
+      {
+        for (int k = rand() % __builtin_popcountll(legal); k > 0; k--)
+        {
+          legal &= legal - 1;
+        }
+        square = __builtin_ctzll(legal);
+      }
+      else if (found != entries.end())
+      {
+        square = OpeningBook::untransformSquare(found->second.move,
+                                                symmetry);
+      }
+      else
+      {
+        Search search(nullptr, &eval);
+        Move best;
+        search.iterativeDeepening(board, side, 4, nullptr, &best);
+        square = best.square;
+      }
+      play(&board, &side, square);
+    }
+    // search as we go, so that later games follow the new book moves
+    searchPending(depth);
+  }
+  return writeBook(path) ? 0 : 1;
+}
+
+static int readGames(const char *records, int plies, int depth,
+                     const char *path)
+{
+  FILE *file = fopen(records, "r");
+  if (file == nullptr)
+  {
+    fprintf(stderr, "could not read %s\n", records);
+    return 1;
+  }
+  char line[1024];
+  int lineNumber = 0;
+  while (fgets(line, sizeof(line), file) != nullptr)
+  {
+    lineNumber++;
+    Board board;
+    Side side = BLACK;
+    int ply = 0;
+    for (char *c = line; ply < plies && c[0] != 0 && c[1] != 0; c += 2)
+    {
+      int x = tolower(c[0]) - 'a';
+      int y = c[1] - '1';
+      if (x < 0 || x > 7 || y < 0 || y > 7)
+      {
+        break; // end of the moves
+      }
+      if (board.legalMoves(side) == 0)
+      {
+        side = flip(side);
+      }
+      addPosition(board, side, depth);
+      if (!play(&board, &side, x + 8 * y))
+      {
+        fprintf(stderr, "line %d: illegal move %c%c\n", lineNumber, c[0],
+                c[1]);
+        break;
+      }
+      ply++;
+    }
+  }
+  fclose(file);
+  searchPending(depth);
+  return writeBook(path) ? 0 : 1;
+}
+
+static int info(const char *path)
+{
+  OpeningBook book;
+  if (!book.open(path))
+  {
+    fprintf(stderr, "could not read %s\n", path);
+    return 1;
+  }
+  printf("%d entries\n", (int) book.size());
+  Board board;
+  Side side = BLACK;
+  Move move;
+  int score;
+  printf("book line:");
+  while (book.probe(board, side, &move, &score))
+  {
+    printf(" %c%c (%+.2f)", 'a' + move.getX(), '1' + move.getY(),
+           (double) score / DISC_WIN_SCALE);
+    play(&board, &side, move.square);
+    if (board.legalMoves(side) == 0)
+    {
+      side = flip(side);
+    }
+  }
+  printf("\n");
+  return 0;
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc >= 5 && (!strcmp(argv[1], "selfplay")
+                 || !strcmp(argv[1], "games")))
+  {
+    int depth = atoi(argv[4]);
+    if (depth < 1 || depth > MAX_DEPTH)
+    {
+      fprintf(stderr, "depth must be between 1 and %d\n", MAX_DEPTH);
+      return 1;
+    }
+    const char *path = (argc >= 6) ? argv[5] : DEFAULT_BOOK_FILE;
+    loadBook(path);
+    if (!strcmp(argv[1], "selfplay"))
+    {
+      return selfPlay(atoi(argv[2]), atoi(argv[3]), depth, path);
+    }
+    return readGames(argv[2], atoi(argv[3]), depth, path);
+  }
+  if (argc >= 2 && !strcmp(argv[1], "info"))
+  {
+    return info((argc >= 3) ? argv[2] : DEFAULT_BOOK_FILE);
+  }
+  fprintf(stderr, "usage: %s selfplay GAMES PLIES DEPTH [FILE]\n"
+                  "       %s games RECORDS PLIES DEPTH [FILE]\n"
+                  "       %s info [FILE]\n", argv[0], argv[0], argv[0]);
+  return 1;
+}
@@ -1,25 +1,36 @@
 #ifndef __COMMON_H__
 #define __COMMON_H__
 
+#include <cstdint>
+
 enum Side { 
     WHITE, BLACK
 };
 
+// Returns the opponent of the given side.
+inline Side flip(Side side) {
+    return (side == BLACK) ? WHITE : BLACK;
+}
+
+// A move is packed into a single byte holding the square index x + 8*y, so
+// that moves can be passed around by value as cheaply as an int. x and y
+// must be 0 to 7; anything else names some other square.
 class Move {
    
 public:
-    int x, y;
+    uint8_t square;
+    Move() {
+        square = 0;
+    }
     Move(int x, int y) {
-        this->x = x;
-        this->y = y;        
+        square = x + 8 * y;
     }
-    ~Move() {}
 
-    int getX() { return x; }
-    int getY() { return y; }
+    int getX() const { return square & 7; }
+    int getY() const { return square >> 3; }
 
-    void setX(int x) { this->x = x; }
-    void setY(int y) { this->y = y; }
+    void setX(int x) { square = (square & ~7) | x; }
+    void setY(int y) { square = (square & 7) | (y << 3); }
 };
 
 #endif
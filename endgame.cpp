@@ -0,0 +1,400 @@
+// Exact endgame solver for the Othello AI
+
+#include "endgame.hpp"
+#include "search.hpp"
+#include <cassert>
+using namespace std;
+
+const int EG_TT_MIN_EMPTIES = 8; // shallower nodes are cheaper to re-solve
+                                 // than to look up
+const int EG_STABILITY_MIN_EMPTIES = 8; // stability cutoffs are only tried
+                                        // where a cutoff saves a big subtree
+const int EG_FASTEST_FIRST_EMPTIES = 7; // below this, counting the
+                                        // opponent's replies costs more than
+                                        // the ordering saves
+
+// the four 4x4 quadrants of the board. playing last in a region tends to be
+// an advantage, so moves in regions with an odd number of empties go first
+static const uint64_t QUADRANTS[4] = {
+  0x000000000f0f0f0fULL, 0x00000000f0f0f0f0ULL,
+  0x0f0f0f0f00000000ULL, 0xf0f0f0f000000000ULL
+};
+
+static inline int quadrant(int square)
+{
+  return ((square >> 2) & 1) | ((square >> 4) & 2);
+}
+
+// returns a bitmask with bit q set if quadrant q holds an odd number of
+// empty squares
+static inline int oddQuadrants(uint64_t empties)
+{
+  int odd = 0;
+  for (int q = 0; q < 4; q++)
+  {
+    odd |= (__builtin_popcountll(empties & QUADRANTS[q]) & 1) << q;
+  }
+  return odd;
+}
+
+// disc difference of a finished game from side's point of view
+static inline int discDifference(const Board &board, Side side)
+{
+  return board.count(side) - board.count(flip(side));
+}
+
+EndgameSolver::EndgameSolver(TranspositionTable *tt)
+{
+  this->tt = tt;
+  timer = nullptr;
+  stop = nullptr;
+  nodes = 0;
+  aborted = false;
+}
+
+int EndgameSolver::solve(const Board &board, Side side, EndgameMode mode,
+                         const TimeManager *timer, Move *best)
+{
+  this->timer = timer;
+  aborted = false;
+  uint64_t legal = board.legalMoves(side);
+  assert(legal != 0); // the caller handles passing
+  int alpha = (mode == SOLVE_WLD) ? -1 : -64;
+  int beta = (mode == SOLVE_WLD) ? 1 : 64;
+  int moves[32];
+  int count = orderMoves(board, side, legal, moves);
+  int bestScore = -INF_SCORE;
+  int bestSquare = moves[0];
+  nodes++;
+  for (int i = 0; i < count; i++)
+  {
+    Board child = board;
+    child.makeMove(moves[i], side);
+    int score = -search(child, flip(side), -beta, -alpha, false);
+    if (aborted)
+    {
+      return 0;
+    }
+    if (score > bestScore)
+    {
+      bestScore = score;
+      bestSquare = moves[i];
+      if (score > alpha)
+      {
+        alpha = score;
+        if (alpha >= beta)
+        {
+          break; // a win is a win in WLD mode
+        }
+      }
+    }
+  }
+  best->square = bestSquare;
+  return bestScore;
+}
+
+// this function orders the legal moves for the general search: odd regions
+// first, and within that the moves that leave the opponent the fewest
+// replies. returns the number of moves written to moves[]
+int EndgameSolver::orderMoves(const Board &board, Side side, uint64_t legal,
+                              int moves[])
+{
+  int odd = oddQuadrants(board.emptySquares());
+  bool fastestFirst = board.countEmpty() >= EG_FASTEST_FIRST_EMPTIES;
+  int keys[32];
+  int count = 0;
+  while (legal)
+  {
+    int square = __builtin_ctzll(legal);
+    legal &= legal - 1;
+    int key = ((odd >> quadrant(square)) & 1) ? 0 : 64;
+    if (fastestFirst)
+    {
+      Board child = board;
+      child.makeMove(square, side);
+      key += child.mobility(flip(side));
+    }
+    // insertion sort; there are rarely more than a dozen moves
+    int i = count++;
+    while (i > 0 && keys[i - 1] > key)
+    {
+      keys[i] = keys[i - 1];
+      moves[i] = moves[i - 1];
+      i--;
+    }
+    keys[i] = key;
+    moves[i] = square;
+  }
+  return count;
+}
+
+// general endgame search for positions with more than four empties. returns
+// the final disc difference for the side to move; values outside
+// (alpha, beta) are only bounds.
+int EndgameSolver::search(const Board &board, Side side, int alpha, int beta,
+                          bool passed)
+{
+  int empties = board.countEmpty();
+  if (empties <= 4)
+  {
+    switch (empties)
+    {
+      case 4: return solve4(board, side, alpha, beta, passed);
+      case 3: return solve3(board, side, alpha, beta, passed);
+      case 2: return solve2(board, side, alpha, beta, passed);
+      case 1: return solve1(board, side, __builtin_ctzll(board.emptySquares()));
+      default: nodes++; return discDifference(board, side);
+    }
+  }
+  nodes++;
+  // checking the clock is comparatively slow, so only do it now and then
+  if ((nodes & 4095) == 0
+   && ((timer != nullptr && timer->outOfTime())
+    || (stop != nullptr && stop->load(memory_order_relaxed))))
+  {
+    aborted = true;
+  }
+  if (aborted)
+  {
+    return 0;
+  }
+  uint64_t legal = board.legalMoves(side);
+  if (legal == 0)
+  {
+    if (passed)
+    {
+      return discDifference(board, side);
+    }
+    return -search(board, flip(side), -beta, -alpha, true);
+  }
+
+  // the opponent keeps its stable discs to the end, which caps our score
+  if (empties >= EG_STABILITY_MIN_EMPTIES)
+  {
+    int upper = 64 - 2 * __builtin_popcountll(board.stableDiscs(flip(side)));
+    if (upper <= alpha)
+    {
+      return upper;
+    }
+  }
+
+  // the table holds Search's units; exact results are stored with the
+  // number of empties as their depth, which is what a full search needs
+  uint64_t key = board.getKey(side);
+  bool useTT = tt != nullptr && empties >= EG_TT_MIN_EMPTIES;
+  int ttMove = -1;
+  TTEntry entry;
+  if (useTT && tt->probe(key, &entry))
+  {
+    if (entry.depth >= empties)
+    {
+      int score = entry.score / DISC_WIN_SCALE;
+      if (entry.bound == BOUND_EXACT
+       || (entry.bound == BOUND_LOWER && score >= beta)
+       || (entry.bound == BOUND_UPPER && score <= alpha))
+      {
+        return score;
+      }
+    }
+    if ((legal >> entry.move) & 1)
+    {
+      ttMove = entry.move;
+    }
+  }
+
+  int moves[32];
+  int count = orderMoves(board, side, legal, moves);
+  if (ttMove >= 0)
+  {
+    // move the table's best move to the front
+    int i = 0;
+    while (moves[i] != ttMove) {i++;}
+    for (; i > 0; i--) {moves[i] = moves[i - 1];}
+    moves[0] = ttMove;
+  }
+  int originalAlpha = alpha;
+  int bestScore = -INF_SCORE;
+  int bestSquare = moves[0];
+  for (int i = 0; i < count; i++)
+  {
+    Board child = board;
+    child.makeMove(moves[i], side);
+    int score = -search(child, flip(side), -beta, -alpha, false);
+    if (aborted)
+    {
+      return 0;
+    }
+    if (score > bestScore)
+    {
+      bestScore = score;
+      bestSquare = moves[i];
+      if (score > alpha)
+      {
+        alpha = score;
+        if (alpha >= beta)
+        {
+          break;
+        }
+      }
+    }
+  }
+  if (useTT)
+  {
+    Bound bound = (bestScore >= beta) ? BOUND_LOWER
+                : (bestScore > originalAlpha) ? BOUND_EXACT : BOUND_UPPER;
+    tt->store(key, empties, bound, bestScore * DISC_WIN_SCALE, bestSquare);
+  }
+  return bestScore;
+}
+
+// four empties: try the squares in odd regions first, then the rest
+int EndgameSolver::solve4(const Board &board, Side side, int alpha, int beta,
+                          bool passed)
+{
+  nodes++;
+  uint64_t empties = board.emptySquares();
+  int odd = oddQuadrants(empties);
+  int squares[4];
+  int n = 0;
+  for (int pass = 0; pass < 2; pass++)
+  {
+    uint64_t e = empties;
+    while (e)
+    {
+      int square = __builtin_ctzll(e);
+      e &= e - 1;
+      bool inOdd = (odd >> quadrant(square)) & 1;
+      if (inOdd == (pass == 0)) {squares[n++] = square;}
+    }
+  }
+  int bestScore = -INF_SCORE;
+  for (int i = 0; i < 4; i++)
+  {
+    uint64_t flips = board.getFlips(squares[i], side);
+    if (flips == 0) {continue;}
+    Board child = board;
+    child.makeMove(squares[i], side, flips);
+    int score = -solve3(child, flip(side), -beta, -alpha, false);
+    if (score > bestScore)
+    {
+      bestScore = score;
+      if (score > alpha)
+      {
+        alpha = score;
+        if (alpha >= beta) {break;}
+      }
+    }
+  }
+  if (bestScore == -INF_SCORE)
+  {
+    // no legal move
+    if (passed) {return discDifference(board, side);}
+    return -solve4(board, flip(side), -beta, -alpha, true);
+  }
+  return bestScore;
+}
+
+// three empties: if one region holds a single empty, play it first
+int EndgameSolver::solve3(const Board &board, Side side, int alpha, int beta,
+                          bool passed)
+{
+  nodes++;
+  uint64_t empties = board.emptySquares();
+  int squares[3];
+  for (int i = 0; i < 3; i++)
+  {
+    squares[i] = __builtin_ctzll(empties);
+    empties &= empties - 1;
+  }
+  // with three empties, exactly one or all three regions are odd. in the
+  // first case the odd square shares no region with the other two
+  if (quadrant(squares[0]) == quadrant(squares[1])
+   && quadrant(squares[0]) != quadrant(squares[2]))
+  {
+    int t = squares[2]; squares[2] = squares[0]; squares[0] = t;
+  }
+  else if (quadrant(squares[0]) == quadrant(squares[2])
+        && quadrant(squares[0]) != quadrant(squares[1]))
+  {
+    int t = squares[1]; squares[1] = squares[0]; squares[0] = t;
+  }
+  int bestScore = -INF_SCORE;
+  for (int i = 0; i < 3; i++)
+  {
+    uint64_t flips = board.getFlips(squares[i], side);
+    if (flips == 0) {continue;}
+    Board child = board;
+    child.makeMove(squares[i], side, flips);
+    int score = -solve2(child, flip(side), -beta, -alpha, false);
+    if (score > bestScore)
+    {
+      bestScore = score;
+      if (score > alpha)
+      {
+        alpha = score;
+        if (alpha >= beta) {break;}
+      }
+    }
+  }
+  if (bestScore == -INF_SCORE)
+  {
+    if (passed) {return discDifference(board, side);}
+    return -solve3(board, flip(side), -beta, -alpha, true);
+  }
+  return bestScore;
+}
+
+int EndgameSolver::solve2(const Board &board, Side side, int alpha, int beta,
+                          bool passed)
+{
+  nodes++;
+  uint64_t empties = board.emptySquares();
+  int squares[2];
+  squares[0] = __builtin_ctzll(empties);
+  squares[1] = __builtin_ctzll(empties & (empties - 1));
+  int bestScore = -INF_SCORE;
+  for (int i = 0; i < 2; i++)
+  {
+    uint64_t flips = board.getFlips(squares[i], side);
+    if (flips == 0) {continue;}
+    Board child = board;
+    child.makeMove(squares[i], side, flips);
+    int score = -solve1(child, flip(side), squares[1 - i]);
+    if (score > bestScore)
+    {
+      bestScore = score;
+      if (score > alpha)
+      {
+        alpha = score;
+        if (alpha >= beta) {break;}
+      }
+    }
+  }
+  if (bestScore == -INF_SCORE)
+  {
+    if (passed) {return discDifference(board, side);}
+    return -solve2(board, flip(side), -beta, -alpha, true);
+  }
+  return bestScore;
+}
+
+// one empty: the result follows from the flip counts alone, without making
+// the move
+int EndgameSolver::solve1(const Board &board, Side side, int square)
+{
+  nodes++;
+  int own = board.count(side);
+  int opp = board.count(flip(side));
+  int flips = __builtin_popcountll(board.getFlips(square, side));
+  if (flips > 0)
+  {
+    return (own + flips + 1) - (opp - flips);
+  }
+  // we have to pass; the opponent may still be able to play there
+  flips = __builtin_popcountll(board.getFlips(square, flip(side)));
+  if (flips > 0)
+  {
+    return (own - flips) - (opp + flips + 1);
+  }
+  return own - opp;
+}
@@ -0,0 +1,59 @@
+#ifndef __ENDGAME_H__
+#define __ENDGAME_H__
+
+#include <atomic>
+#include "common.hpp"
+#include "board.hpp"
+#include "timemanager.hpp"
+#include "tt.hpp"
+
+// Exact endgame solver for the Othello AI. Once few enough squares are left
+// the game can be searched to the very end, and positions are scored by the
+// final disc difference instead of the heuristic. The last four empties are
+// handled by unrolled routines; above that, moves are ordered by parity
+// (odd regions first) and by how few replies they leave the opponent.
+
+using namespace std;
+
+const int ENDGAME_FALLBACK_DEPTH = 6; // depth of the midgame search used when
+                                     // a solve cannot finish
+
+enum EndgameMode {
+  SOLVE_WLD, // only find out whether the position is a win, loss or draw
+  SOLVE_EXACT // find the exact final disc difference
+};
+
+class EndgameSolver {
+public:
+  long long nodes; // positions visited since construction
+  bool aborted; // set when the time manager stopped the solve
+  const atomic<bool> *stop; // if set, the solve also gives up soon after
+                            // *stop becomes true
+
+  // tt may be nullptr; results are stored in it in the same units as Search
+  EndgameSolver(TranspositionTable *tt = nullptr);
+  // solves the position for side and stores the best move in *best. returns
+  // the final disc difference from side's point of view; in SOLVE_WLD mode
+  // only its sign is meaningful. side must have at least one legal move.
+  // timer may be nullptr for no time limit.
+  int solve(const Board &board, Side side, EndgameMode mode,
+            const TimeManager *timer, Move *best);
+
+private:
+  TranspositionTable *tt;
+  const TimeManager *timer;
+
+  int search(const Board &board, Side side, int alpha, int beta,
+             bool passed);
+  int solve4(const Board &board, Side side, int alpha, int beta,
+             bool passed);
+  int solve3(const Board &board, Side side, int alpha, int beta,
+             bool passed);
+  int solve2(const Board &board, Side side, int alpha, int beta,
+             bool passed);
+  int solve1(const Board &board, Side side, int square);
+  int orderMoves(const Board &board, Side side, uint64_t legal,
+                 int moves[]);
+};
+
+#endif
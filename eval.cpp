@@ -0,0 +1,383 @@
+// Pattern-based evaluation for the Othello AI
+
+#include "eval.hpp"
+#include "search.hpp"
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+using namespace std;
+
+// each pattern type is given by its squares in the top left corner of the
+// board, as (x, y) pairs. the other instances are its images under the
+// board's eight symmetries, with duplicate square sets dropped
+struct PatternShape {
+  int size;
+  int xy[EVAL_MAX_PATTERN_SIZE][2];
+};
+
+static const PatternShape SHAPES[EVAL_PATTERN_TYPES] = {
+  // edge plus the two X squares
+  {10, {{0,0},{1,0},{2,0},{3,0},{4,0},{5,0},{6,0},{7,0},{1,1},{6,1}}},
+  // 3x3 corner
+  {9, {{0,0},{1,0},{2,0},{0,1},{1,1},{2,1},{0,2},{1,2},{2,2}}},
+  // 2x5 corner
+  {10, {{0,0},{1,0},{2,0},{3,0},{4,0},{0,1},{1,1},{2,1},{3,1},{4,1}}},
+  // second, third and fourth rows
+  {8, {{0,1},{1,1},{2,1},{3,1},{4,1},{5,1},{6,1},{7,1}}},
+  {8, {{0,2},{1,2},{2,2},{3,2},{4,2},{5,2},{6,2},{7,2}}},
+  {8, {{0,3},{1,3},{2,3},{3,3},{4,3},{5,3},{6,3},{7,3}}},
+  // diagonals of length 8 down to 4
+  {8, {{0,0},{1,1},{2,2},{3,3},{4,4},{5,5},{6,6},{7,7}}},
+  {7, {{1,0},{2,1},{3,2},{4,3},{5,4},{6,5},{7,6}}},
+  {6, {{2,0},{3,1},{4,2},{5,3},{6,4},{7,5}}},
+  {5, {{3,0},{4,1},{5,2},{6,3},{7,4}}},
+  {4, {{4,0},{5,1},{6,2},{7,3}}}
+};
+
+static const int POW3[EVAL_MAX_PATTERN_SIZE + 1] = {
+  1, 3, 9, 27, 81, 243, 729, 2187, 6561, 19683, 59049
+};
+
+static int symmetry(int s, int x, int y)
+{
+  if (s & 1) {x = 7 - x;}
+  if (s & 2) {y = 7 - y;}
+  if (s & 4) {int t = x; x = y; y = t;}
+  return x + 8 * y;
+}
+
+Evaluator::Evaluator()
+{
+  int n = 0;
+  int offset = 0;
+  for (int t = 0; t < EVAL_PATTERN_TYPES; t++)
+  {
+    offsets[t] = offset;
+    offset += POW3[SHAPES[t].size];
+    uint64_t seen[8];
+    int seenCount = 0;
+    for (int s = 0; s < 8; s++)
+    {
+      PatternInstance p;
+      p.type = t;
+      p.size = SHAPES[t].size;
+      uint64_t mask = 0;
+      for (int k = 0; k < p.size; k++)
+      {
+        p.squares[k] = symmetry(s, SHAPES[t].xy[k][0], SHAPES[t].xy[k][1]);
+        mask |= 1ULL << p.squares[k];
+      }
+      bool duplicate = false;
+      for (int i = 0; i < seenCount; i++)
+      {
+        if (seen[i] == mask) {duplicate = true;}
+      }
+      if (duplicate) {continue;}
+      seen[seenCount++] = mask;
+      instances[n++] = p;
+    }
+  }
+  for (int sq = 0; sq < 64; sq++)
+  {
+    uses[sq].count = 0;
+  }
+  for (int i = 0; i < EVAL_INSTANCES; i++)
+  {
+    for (int k = 0; k < instances[i].size; k++)
+    {
+      SquareUse &u = uses[instances[i].squares[k]];
+      assert(u.count < EVAL_MAX_SQUARE_USES);
+      u.instance[u.count] = (uint8_t) i;
+      u.power[u.count] = (uint16_t) POW3[instances[i].size - 1 - k];
+      u.count++;
+    }
+  }
+  weights.assign(EVAL_PHASES * weightsPerPhase(), 0);
+  setDefaultWeights();
+}
+
+int Evaluator::boardWeightIndex()
+{
+  int total = 0;
+  for (int t = 0; t < EVAL_PATTERN_TYPES; t++)
+  {
+    total += POW3[SHAPES[t].size];
+  }
+  return total;
+}
+
+int Evaluator::weightsPerPhase()
+{
+  return boardWeightIndex() + EVAL_BOARD_FEATURES;
+}
+
+// built-in weights of the whole-board features, in discs per unit of
+// difference. stability as in Board::getWhiteValue; the others are the
+// usual midgame rules of thumb: have more moves than the opponent, and
+// fewer discs where the opponent can get at them
+static const double DEFAULT_BOARD_WEIGHTS[EVAL_BOARD_FEATURES] = {
+  0.75, 0.5, 0.25, -0.25
+};
+
+// this function fills in weights that reproduce Board::getWhiteValue, the
+// corner/edge/normal square values and the bonus for stable discs, and
+// adds the other whole-board features. each square's value is shared
+// evenly among the instances that cover it, so that summed over all
+// instances every disc counts once
+void Evaluator::setDefaultWeights()
+{
+  const double POINT_DISCS = 0.25; // one old heuristic point in discs
+  double value[64];
+  int coverage[64] = {0};
+  for (int i = 0; i < EVAL_INSTANCES; i++)
+  {
+    for (int k = 0; k < instances[i].size; k++)
+    {
+      coverage[instances[i].squares[k]]++;
+    }
+  }
+  for (int sq = 0; sq < 64; sq++)
+  {
+    int x = sq % 8;
+    int y = sq / 8;
+    bool edgeX = (x == 0 || x == 7);
+    bool edgeY = (y == 0 || y == 7);
+    double points = (edgeX && edgeY) ? 5 : (edgeX || edgeY) ? 3 : 1;
+    value[sq] = points * POINT_DISCS * WEIGHT_SCALE / coverage[sq];
+  }
+  int perPhase = weightsPerPhase();
+  for (int phase = 0; phase < EVAL_PHASES; phase++)
+  {
+    for (int k = 0; k < EVAL_BOARD_FEATURES; k++)
+    {
+      weights[phase * perPhase + boardWeightIndex() + k] =
+        (int16_t) lround(DEFAULT_BOARD_WEIGHTS[k] * WEIGHT_SCALE);
+    }
+  }
+  for (int i = 0; i < EVAL_INSTANCES; i++)
+  {
+    const PatternInstance &p = instances[i];
+    // only the first instance of each type needs to fill the table; the
+    // values are the same under symmetry
+    if (i > 0 && instances[i - 1].type == p.type) {continue;}
+    for (int index = 0; index < POW3[p.size]; index++)
+    {
+      double w = 0;
+      int rest = index;
+      for (int k = p.size - 1; k >= 0; k--)
+      {
+        int state = rest % 3;
+        rest /= 3;
+        if (state == 1) {w += value[p.squares[k]];}
+        else if (state == 2) {w -= value[p.squares[k]];}
+      }
+      for (int phase = 0; phase < EVAL_PHASES; phase++)
+      {
+        weights[phase * perPhase + offsets[p.type] + index] =
+          (int16_t) lround(w);
+      }
+    }
+  }
+}
+
+int Evaluator::phaseOf(const Board &board)
+{
+  int discs = 64 - board.countEmpty();
+  int phase = (discs - 4) * EVAL_PHASES / 61;
+  return (phase < 0) ? 0 : (phase >= EVAL_PHASES) ? EVAL_PHASES - 1 : phase;
+}
+
+// squares next to any of the given ones, in all eight directions
+static inline uint64_t neighbours(uint64_t b)
+{
+  const uint64_t NOT_COL_0 = 0xfefefefefefefefeULL;
+  const uint64_t NOT_COL_7 = 0x7f7f7f7f7f7f7f7fULL;
+  uint64_t east = (b << 1) & NOT_COL_0;
+  uint64_t west = (b >> 1) & NOT_COL_7;
+  uint64_t row = b | east | west;
+  return (row | (row << 8) | (row >> 8)) & ~b;
+}
+
+// counts the whole-board features for side. the full stable disc count
+// needs a few passes over the board and hardly differs from the edges'
+// before the last few dozen empties, so until then only the edges count
+void Evaluator::countBoardFeatures(const Board &board, Side side,
+                                   int counts[EVAL_BOARD_FEATURES]) const
+{
+  uint64_t own = board.discs(side);
+  uint64_t opp = board.discs(flip(side));
+  uint64_t empty = board.emptySquares();
+  uint64_t nearEmpty = neighbours(empty);
+  if (board.countEmpty() <= STABLE_INTERIOR_EMPTIES)
+  {
+    counts[FEATURE_STABLE] =
+      __builtin_popcountll(board.stableDiscs(side))
+      - __builtin_popcountll(board.stableDiscs(flip(side)));
+  }
+  else
+  {
+    uint64_t stable = board.stableEdges();
+    counts[FEATURE_STABLE] = __builtin_popcountll(stable & own)
+                           - __builtin_popcountll(stable & opp);
+  }
+  counts[FEATURE_MOBILITY] =
+    board.mobility(side) - board.mobility(flip(side));
+  counts[FEATURE_POTENTIAL_MOBILITY] =
+    __builtin_popcountll(neighbours(opp) & empty)
+    - __builtin_popcountll(neighbours(own) & empty);
+  counts[FEATURE_FRONTIER] =
+    __builtin_popcountll(own & nearEmpty)
+    - __builtin_popcountll(opp & nearEmpty);
+}
+
+int Evaluator::features(const Board &board, Side side,
+                        int features[EVAL_INSTANCES],
+                        int boardFeatures[EVAL_BOARD_FEATURES]) const
+{
+  EvalState state;
+  initState(board, &state);
+  for (int i = 0; i < EVAL_INSTANCES; i++)
+  {
+    features[i] = offsets[instances[i].type] + state.index[side][i];
+  }
+  countBoardFeatures(board, side, boardFeatures);
+  return phaseOf(board);
+}
+
+// a disc adds its place value to its side's index and twice that to the
+// opponent's
+void Evaluator::initState(const Board &board, EvalState *state) const
+{
+  memset(state, 0, sizeof(*state));
+  for (int c = 0; c < 2; c++)
+  {
+    Side side = (Side) c;
+    uint16_t *own = state->index[side];
+    uint16_t *opp = state->index[flip(side)];
+    uint64_t discs = board.discs(side);
+    while (discs)
+    {
+      const SquareUse &u = uses[__builtin_ctzll(discs)];
+      discs &= discs - 1;
+      for (int j = 0; j < u.count; j++)
+      {
+        own[u.instance[j]] += u.power[j];
+        opp[u.instance[j]] += 2 * u.power[j];
+      }
+    }
+  }
+}
+
+// the digit of the square played goes from 0 (empty) to 1 for the mover
+// and to 2 for the opponent; a flipped disc's goes from 2 to 1 for the
+// mover and from 1 to 2 for the opponent
+void Evaluator::updateState(const EvalState &parent, int square,
+                            uint64_t flips, Side side,
+                            EvalState *child) const
+{
+  *child = parent;
+  uint16_t *own = child->index[side];
+  uint16_t *opp = child->index[flip(side)];
+  const SquareUse &u = uses[square];
+  for (int j = 0; j < u.count; j++)
+  {
+    own[u.instance[j]] += u.power[j];
+    opp[u.instance[j]] += 2 * u.power[j];
+  }
+  while (flips)
+  {
+    const SquareUse &f = uses[__builtin_ctzll(flips)];
+    flips &= flips - 1;
+    for (int j = 0; j < f.count; j++)
+    {
+      own[f.instance[j]] -= f.power[j];
+      opp[f.instance[j]] += f.power[j];
+    }
+  }
+}
+
+int Evaluator::evaluate(const Board &board, Side side) const
+{
+  EvalState state;
+  initState(board, &state);
+  return evaluate(board, side, state);
+}
+
+int Evaluator::evaluate(const Board &board, Side side,
+                        const EvalState &state) const
+{
+  int f[EVAL_BOARD_FEATURES];
+  countBoardFeatures(board, side, f);
+  const int16_t *w = &weights[phaseOf(board) * weightsPerPhase()];
+  int sum = 0;
+  for (int k = 0; k < EVAL_BOARD_FEATURES; k++)
+  {
+    sum += f[k] * w[boardWeightIndex() + k];
+  }
+  const uint16_t *index = state.index[side];
+  for (int i = 0; i < EVAL_INSTANCES; i++)
+  {
+    sum += w[offsets[instances[i].type] + index[i]];
+  }
+  return (int) ((int64_t) sum * DISC_WIN_SCALE / WEIGHT_SCALE);
+}
+
+bool Evaluator::load(const char *path)
+{
+  FILE *file = fopen(path, "rb");
+  if (file == nullptr)
+  {
+    return false;
+  }
+  // version 1 had the stable disc weight but no other board features
+  const int V1_MISSING = EVAL_BOARD_FEATURES - 1;
+  char magic[4];
+  uint32_t header[3];
+  bool ok = fread(magic, 1, 4, file) == 4 && memcmp(magic, "OTHW", 4) == 0
+         && fread(header, 4, 3, file) == 3 && header[1] == EVAL_PHASES
+         && ((header[0] == EVAL_FILE_VERSION
+              && header[2] == (uint32_t) weightsPerPhase())
+          || (header[0] == 1
+              && header[2] == (uint32_t) (weightsPerPhase() - V1_MISSING)));
+  if (ok)
+  {
+    vector<int16_t> loaded(EVAL_PHASES * header[2]);
+    ok = fread(&loaded[0], 2, loaded.size(), file) == loaded.size();
+    if (ok && header[0] == 1)
+    {
+      vector<int16_t> upgraded;
+      for (int phase = 0; phase < EVAL_PHASES; phase++)
+      {
+        upgraded.insert(upgraded.end(), loaded.begin() + phase * header[2],
+                        loaded.begin() + (phase + 1) * header[2]);
+        for (int k = EVAL_BOARD_FEATURES - V1_MISSING;
+             k < EVAL_BOARD_FEATURES; k++)
+        {
+          upgraded.push_back(
+            (int16_t) lround(DEFAULT_BOARD_WEIGHTS[k] * WEIGHT_SCALE));
+        }
+      }
+      loaded.swap(upgraded);
+    }
+    if (ok) {weights.swap(loaded);}
+  }
+  fclose(file);
+  return ok;
+}
+
+bool Evaluator::save(const char *path) const
+{
+  FILE *file = fopen(path, "wb");
+  if (file == nullptr)
+  {
+    return false;
+  }
+  uint32_t header[3] = {
+    EVAL_FILE_VERSION, EVAL_PHASES, (uint32_t) weightsPerPhase()
+  };
+  bool ok = fwrite("OTHW", 1, 4, file) == 4
+         && fwrite(header, 4, 3, file) == 3
+         && fwrite(&weights[0], 2, weights.size(), file) == weights.size();
+  return fclose(file) == 0 && ok;
+}
@@ -0,0 +1,124 @@
+#ifndef __EVAL_H__
+#define __EVAL_H__
+
+#include <cstdint>
+#include <vector>
+#include "common.hpp"
+#include "board.hpp"
+
+// Pattern-based evaluation in the style of Logistello and Edax. The board is
+// covered by 46 pattern instances (edges with their X squares, 3x3 and 2x5
+// corners, rows and diagonals), each an instance of one of 11 pattern types
+// under the board's symmetries. An instance reads its squares as a base-3
+// number (0 empty, 1 own, 2 opponent) and looks that number up in its
+// type's weight table. The evaluation is the sum of the lookups, plus a
+// weight for each of four whole-board features times the side to move's
+// count minus the opponent's: stable discs, mobility (legal moves),
+// potential mobility (empty squares next to an opponent's disc) and
+// frontier discs (discs next to an empty square). Each game phase, by
+// number of discs on the board, has its own set of tables.
+//
+// The search keeps the pattern indices up to date move by move in an
+// EvalState, so that a leaf only has to add up its lookups; the
+// whole-board features are counted at the leaf from the bitboards. The
+// stable disc count only looks past the edges near the end of the game,
+// when discs away from the edges start to become stable.
+//
+// Weights are int16 in 1/WEIGHT_SCALE of a disc and are loaded from a binary
+// file:
+//   char[4]  "OTHW"
+//   uint32   version (EVAL_FILE_VERSION)
+//   uint32   number of phases (EVAL_PHASES)
+//   uint32   weights per phase (Evaluator::weightsPerPhase())
+//   int16    weights, phase by phase: pattern type by pattern type, then
+//            the whole-board feature weights in the order above
+// all little-endian. Version 1 files, which only have the stable disc
+// weight, still load, with the built-in weights for the other three.
+
+using namespace std;
+
+const int EVAL_PHASES = 12;
+const int EVAL_PATTERN_TYPES = 11;
+const int EVAL_INSTANCES = 46;
+const int EVAL_MAX_PATTERN_SIZE = 10;
+const int WEIGHT_SCALE = 128;
+const int EVAL_BOARD_FEATURES = 4;
+const int EVAL_MAX_SQUARE_USES = 8; // most instances covering one square
+const uint32_t EVAL_FILE_VERSION = 2;
+
+// the whole-board features, in the order of their weights
+enum BoardFeature {
+  FEATURE_STABLE, FEATURE_MOBILITY, FEATURE_POTENTIAL_MOBILITY,
+  FEATURE_FRONTIER
+};
+const char DEFAULT_WEIGHTS_FILE[] = "othello.weights";
+const int STABLE_INTERIOR_EMPTIES = 24; // from here on the stable disc
+                                        // count includes the interior
+
+struct PatternInstance {
+  int type;
+  int size;
+  int squares[EVAL_MAX_PATTERN_SIZE];
+};
+
+// every instance's index (its base-3 number) from each side's point of view,
+// indexed by Side
+struct EvalState {
+  uint16_t index[2][EVAL_INSTANCES];
+};
+
+// the instances a square belongs to, with the place value of its digit in
+// each
+struct SquareUse {
+  int count;
+  uint8_t instance[EVAL_MAX_SQUARE_USES];
+  uint16_t power[EVAL_MAX_SQUARE_USES];
+};
+
+class Evaluator {
+public:
+  // starts out with weights derived from the corner/edge/normal square
+  // values of Board::getWhiteValue, so it plays sensibly without a file
+  Evaluator();
+  bool load(const char *path); // returns false and keeps the current
+                               // weights if the file is missing or invalid
+  bool save(const char *path) const;
+
+  // returns the evaluation of the board for side, in the same units as
+  // Search's scores (discs times DISC_WIN_SCALE)
+  int evaluate(const Board &board, Side side) const;
+  // the same, with the pattern indices taken from state, which must be the
+  // board's
+  int evaluate(const Board &board, Side side, const EvalState &state) const;
+
+  // computes the pattern indices of the board from scratch
+  void initState(const Board &board, EvalState *state) const;
+  // sets *child to the state after side plays square, flipping flips, in
+  // the position of parent
+  void updateState(const EvalState &parent, int square, uint64_t flips,
+                   Side side, EvalState *child) const;
+
+  // feature extraction shared with the trainer: writes the offset of every
+  // instance's table entry within its phase into features[], the
+  // whole-board feature differences into boardFeatures[], and returns the
+  // phase. the evaluation is the sum of weights[phase][features[i]] plus
+  // the sum of boardFeatures[k] times weights[phase][boardWeightIndex() + k]
+  int features(const Board &board, Side side, int features[EVAL_INSTANCES],
+               int boardFeatures[EVAL_BOARD_FEATURES]) const;
+  static int phaseOf(const Board &board);
+  static int weightsPerPhase();
+  static int boardWeightIndex();
+
+  vector<int16_t> weights; // EVAL_PHASES * weightsPerPhase() entries
+
+private:
+  PatternInstance instances[EVAL_INSTANCES];
+  int offsets[EVAL_PATTERN_TYPES]; // start of each type's table in a phase
+  SquareUse uses[64];
+
+  void setDefaultWeights();
+  void countBoardFeatures(const Board &board, Side side,
+                          int counts[EVAL_BOARD_FEATURES]) const;
+};
+
+#endif
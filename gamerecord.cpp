@@ -0,0 +1,262 @@
+// Binary game records for the Othello AI
+
+#include "gamerecord.hpp"
+#include "ordering.hpp"
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+using namespace std;
+
+static_assert(sizeof(RecordHeader) == 16, "file layout");
+
+const size_t FILE_HEADER_BYTES = 8;
+const size_t BLOCK_HEADER_BYTES = 8;
+
+static size_t gameBytes(const RecordHeader &header)
+{
+  size_t perPly = (header.flags & RECORD_HAS_EVALS) ? 3 : 1;
+  return sizeof(RecordHeader) + header.plies * perPly;
+}
+
+int GameView::eval(int ply) const
+{
+  int16_t value;
+  memcpy(&value, evals + 2 * ply, 2);
+  return value;
+}
+
+RecordWriter::RecordWriter()
+{
+  file = nullptr;
+  blockGames = 0;
+  ok = false;
+}
+
+RecordWriter::~RecordWriter()
+{
+  close();
+}
+
+bool RecordWriter::open(const char *path)
+{
+  close();
+  file = fopen(path, "wb");
+  if (file == nullptr)
+  {
+    return false;
+  }
+  block.reserve(RECORD_BLOCK_BYTES + sizeof(GameRecord));
+  block.clear();
+  blockGames = 0;
+  uint32_t version = RECORD_FILE_VERSION;
+  ok = fwrite("OTHG", 1, 4, file) == 4 && fwrite(&version, 4, 1, file) == 1;
+  return ok;
+}
+
+bool RecordWriter::write(const GameRecord &game)
+{
+  if (file == nullptr || !ok)
+  {
+    return false;
+  }
+  const uint8_t *header = (const uint8_t *) &game.header;
+  block.insert(block.end(), header, header + sizeof(RecordHeader));
+  block.insert(block.end(), game.moves, game.moves + game.header.plies);
+  if (game.header.flags & RECORD_HAS_EVALS)
+  {
+    const uint8_t *evals = (const uint8_t *) game.evals;
+    block.insert(block.end(), evals, evals + 2 * game.header.plies);
+  }
+  blockGames++;
+  if (block.size() >= RECORD_BLOCK_BYTES)
+  {
+    ok = flush();
+  }
+  return ok;
+}
+
+bool RecordWriter::close()
+{
+  if (file == nullptr)
+  {
+    return false;
+  }
+  ok = ok && flush();
+  ok = fclose(file) == 0 && ok;
+  file = nullptr;
+  return ok;
+}
+
+// writes the block being filled, if it has any games
+bool RecordWriter::flush()
+{
+  if (blockGames == 0)
+  {
+    return true;
+  }
+  uint32_t bytes = block.size();
+  bool written = fwrite(&bytes, 4, 1, file) == 1
+              && fwrite(&blockGames, 4, 1, file) == 1
+              && fwrite(block.data(), 1, block.size(), file) == block.size();
+  block.clear();
+  blockGames = 0;
+  return written;
+}
+
+RecordReader::RecordReader()
+{
+  damaged = false;
+  mapping = nullptr;
+  mappingSize = 0;
+  position = nullptr;
+  blockEnd = nullptr;
+  blockGamesLeft = 0;
+}
+
+RecordReader::~RecordReader()
+{
+  close();
+}
+
+bool RecordReader::open(const char *path)
+{
+  close();
+  int fd = ::open(path, O_RDONLY);
+  if (fd < 0)
+  {
+    return false;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0 || (size_t) info.st_size < FILE_HEADER_BYTES)
+  {
+    ::close(fd);
+    return false;
+  }
+  size_t size = info.st_size;
+  void *data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  // the mapping stays valid after the descriptor is closed
+  ::close(fd);
+  if (data == MAP_FAILED)
+  {
+    return false;
+  }
+  uint32_t version;
+  memcpy(&version, (const uint8_t *) data + 4, 4);
+  if (memcmp(data, "OTHG", 4) != 0 || version != RECORD_FILE_VERSION)
+  {
+    munmap(data, size);
+    return false;
+  }
+  // games are read front to back
+  madvise(data, size, MADV_SEQUENTIAL);
+  mapping = data;
+  mappingSize = size;
+  rewind();
+  return true;
+}
+
+void RecordReader::close()
+{
+  if (mapping != nullptr)
+  {
+    munmap(mapping, mappingSize);
+  }
+  mapping = nullptr;
+  mappingSize = 0;
+  position = nullptr;
+  blockEnd = nullptr;
+  blockGamesLeft = 0;
+  damaged = false;
+}
+
+void RecordReader::rewind()
+{
+  damaged = false;
+  position = (const uint8_t *) mapping + FILE_HEADER_BYTES;
+  blockEnd = position;
+  blockGamesLeft = 0;
+}
+
+bool RecordReader::next(GameView *game)
+{
+  if (mapping == nullptr || damaged)
+  {
+    return false;
+  }
+  const uint8_t *fileEnd = (const uint8_t *) mapping + mappingSize;
+  while (blockGamesLeft == 0)
+  {
+    // on to the next block, ignoring whatever is left of this one
+    position = blockEnd;
+    if (position == fileEnd)
+    {
+      return false;
+    }
+    if ((size_t) (fileEnd - position) < BLOCK_HEADER_BYTES)
+    {
+      damaged = true;
+      return false;
+    }
+    uint32_t bytes;
+    memcpy(&bytes, position, 4);
+    if ((size_t) (fileEnd - position) - BLOCK_HEADER_BYTES < bytes)
+    {
+      damaged = true;
+      return false;
+    }
+    memcpy(&blockGamesLeft, position + 4, 4);
+    position += BLOCK_HEADER_BYTES;
+    blockEnd = position + bytes;
+  }
+  if ((size_t) (blockEnd - position) < sizeof(RecordHeader))
+  {
+    damaged = true;
+    return false;
+  }
+  memcpy(&game->header, position, sizeof(RecordHeader));
+  size_t bytes = gameBytes(game->header);
+  if ((size_t) (blockEnd - position) < bytes)
+  {
+    damaged = true;
+    return false;
+  }
+  game->moves = position + sizeof(RecordHeader);
+  game->evals = (game->header.flags & RECORD_HAS_EVALS)
+              ? game->moves + game->header.plies : nullptr;
+  position += bytes;
+  blockGamesLeft--;
+  return true;
+}
+
+bool RecordReader::replay(const GameView &game, int plies, Board *board,
+                          Side *side)
+{
+  *board = Board();
+  *side = BLACK;
+  for (int i = 0; i < plies && i < game.header.plies; i++)
+  {
+    int square = game.moves[i];
+    if (square == NO_MOVE)
+    {
+      if (board->hasMoves(*side))
+      {
+        return false;
+      }
+    }
+    else
+    {
+      // the same check as Board::doMove, with the flips computed once
+      uint64_t flips = (square < NO_MOVE) ? board->getFlips(square, *side)
+                                          : 0;
+      if (flips == 0 || !((board->emptySquares() >> square) & 1))
+      {
+        return false;
+      }
+      board->makeMove(square, *side, flips);
+    }
+    *side = flip(*side);
+  }
+  return true;
+}
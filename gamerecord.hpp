@@ -0,0 +1,127 @@
+#ifndef __GAMERECORD_H__
+#define __GAMERECORD_H__
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+#include "common.hpp"
+#include "board.hpp"
+
+// Binary game records. A game is a 16-byte RecordHeader followed by one
+// byte per ply, the square played or NO_MOVE for a pass, and, if the
+// header says so, one int16 evaluation per ply. Games are packed into
+// blocks of about RECORD_BLOCK_BYTES so that a reader can check and skip
+// them without parsing every game:
+//   char[4]      "OTHG"
+//   uint32       version (RECORD_FILE_VERSION)
+//   then any number of blocks:
+//     uint32     bytes in the block after this 8-byte block header
+//     uint32     number of games in the block
+//     games      header, moves, evaluations, with no padding
+// all little-endian. Every game starts from the usual initial position, so
+// a record needs no board; replaying the moves gives every position.
+
+using namespace std;
+
+const uint32_t RECORD_FILE_VERSION = 1;
+const size_t RECORD_BLOCK_BYTES = 65536;
+const int MAX_RECORD_PLIES = 255;
+
+// RecordHeader::flags
+const uint8_t RECORD_HAS_EVALS = 1;
+const uint8_t RECORD_FORFEIT = 2; // the margin is then +-64 for the winner
+
+struct RecordHeader {
+  uint8_t plies; // moves and passes
+  uint8_t flags;
+  int8_t margin; // black's discs minus white's at the end
+  uint8_t reserved;
+  uint16_t engine[2]; // who played each side, indexed by Side; the numbers
+                      // mean whatever the writer wants them to
+  uint32_t ms[2]; // clock time each side used, indexed by Side
+};
+
+// a game to write, with room for the longest one so that filling it in
+// allocates nothing
+struct GameRecord {
+  RecordHeader header;
+  uint8_t moves[MAX_RECORD_PLIES];
+  int16_t evals[MAX_RECORD_PLIES]; // hundredths of a disc, from the mover's
+                                   // point of view
+};
+
+// a game as it lies in a mapped file. moves and evals point into the file
+struct GameView {
+  RecordHeader header;
+  const uint8_t *moves;
+  const uint8_t *evals; // nullptr if the game has none
+
+  int eval(int ply) const;
+};
+
+// writes a record file one game at a time, a block at a time
+class RecordWriter {
+public:
+  RecordWriter();
+  ~RecordWriter();
+  // creates or truncates the file. returns false if it cannot be written
+  bool open(const char *path);
+  // adds a game; games longer than MAX_RECORD_PLIES are cut short. returns
+  // false once writing has failed
+  bool write(const GameRecord &game);
+  // writes the last block and closes the file. returns false if any write
+  // failed
+  bool close();
+
+private:
+  FILE *file;
+  vector<uint8_t> block; // the block being filled, without its header
+  uint32_t blockGames;
+  bool ok;
+
+  bool flush();
+
+  RecordWriter(const RecordWriter &);
+  RecordWriter &operator=(const RecordWriter &);
+};
+
+// reads a record file through a read-only memory map, so games are not
+// copied and nothing is allocated per game
+class RecordReader {
+public:
+  bool damaged; // set when next() stopped at a block or game that does not
+                // fit in the file
+
+  RecordReader();
+  ~RecordReader();
+  // maps a record file, replacing any file already open. returns false if
+  // it is missing or not a record file
+  bool open(const char *path);
+  void close();
+  // goes back to the first game
+  void rewind();
+  // stores the next game in *game and returns true, or returns false at the
+  // end of the file
+  bool next(GameView *game);
+
+  size_t size() const {return mappingSize;}
+
+  // plays the game's first plies plies from the initial position, leaving
+  // the position in *board and the side to move in *side. returns false if
+  // the record holds an illegal move or pass
+  static bool replay(const GameView &game, int plies, Board *board,
+                     Side *side);
+
+private:
+  void *mapping;
+  size_t mappingSize;
+  const uint8_t *position; // the next game
+  const uint8_t *blockEnd; // the end of the current block
+  uint32_t blockGamesLeft;
+
+  RecordReader(const RecordReader &);
+  RecordReader &operator=(const RecordReader &);
+};
+
+#endif
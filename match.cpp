@@ -0,0 +1,768 @@
+// Native match runner for the Othello AI.
+//
+//   match [-games N] [-concurrency N] [-threads N] [-time MS]
+//         [-openings PLIES] [-seed N] [-record FILE] ENGINE1 ENGINE2
+//
+// Plays N games (default 100) between two engines, as many at once as
+// there are cores unless -concurrency says otherwise, and reports the
+// result and the Elo difference of ENGINE1 over ENGINE2 with its 95%
+// confidence interval.
+//
+// An ENGINE is the command line of a player program, such as
+// "./AnyhowSayOne -hash 32" (the side is inserted as the first argument),
+// or "internal" followed by the same options, to link the engine of this
+// build into the runner instead. Programs speak the protocol of
+// wrapper.cpp and are started afresh for every game, unless their options
+// include "-protocol extended": then each worker keeps one process per
+// engine for all its games, and tells it the opponent played the move it
+// pondered on with "ponderhit". Replies are waited for with poll() rather
+// than a sleep loop, and the programs' stderr is discarded.
+//
+// Both engines, programs and internal ones alike, are given -threads N
+// (default 1) ahead of their own options, so that they search with the
+// same number of threads and do not take each other's cores; an engine's
+// own -threads option still wins.
+//
+// Each side has MS milliseconds for the whole game (default 10000; 0 for
+// untimed games). As in OthelloGame, the time between sending a move and
+// getting the reply comes off the clock, and a side that runs out of time,
+// plays an illegal move or stops responding loses the game.
+//
+// Every game starts from a random opening of PLIES plies (default 8; 0 to
+// start from the initial position), passed to the engines with -opening,
+// and every opening is played twice with the colors swapped. Openings are
+// drawn from -seed, so the same seed gives the same openings.
+//
+// With -record, every game is also written to FILE in the format of
+// gamerecord.hpp, opening included, with ENGINE1 and ENGINE2 as engines 1
+// and 2 and the margin of a forfeited game as +-64.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "board.hpp"
+#include "player.hpp"
+#include "gamerecord.hpp"
+using namespace std;
+
+const int DEFAULT_MATCH_GAMES = 100;
+const int DEFAULT_MATCH_MS = 10000;
+const int DEFAULT_OPENING_PLIES = 8;
+const int INIT_TIMEOUT_MS = 30000; // as long as a player may take to start
+const int QUIT_TIMEOUT_MS = 1000; // before a program that does not exit at
+                                  // the end of its input is killed
+
+// one side of a game
+class MatchEngine {
+public:
+  string error; // why the engine failed, if it did
+
+  virtual ~MatchEngine() {}
+  // prepares the engine to play side from the opening, given as text like
+  // "f5d6c3d3". returns false on failure
+  virtual bool start(Side side, const string &opening) = 0;
+  // asks for a move. opponentsMove is nullptr for the first move or after
+  // a pass, and msLeft is -1 in an untimed game. stores the reply in
+  // *reply, or sets *passed. returns false on failure
+  virtual bool move(const Move *opponentsMove, int msLeft, Move *reply,
+                    bool *passed) = 0;
+};
+
+// a player program on the other end of two pipes
+class ProgramEngine : public MatchEngine {
+public:
+  ProgramEngine(const vector<string> &command);
+  ~ProgramEngine();
+  bool start(Side side, const string &opening);
+  bool move(const Move *opponentsMove, int msLeft, Move *reply,
+            bool *passed);
+
+private:
+  vector<string> command;
+  bool extended; // speaks the extended protocol
+  pid_t pid;
+  int input; // the program's stdin
+  int output; // the program's stdout
+  string buffered; // output read but not yet consumed
+  int ponderSquare; // the reply it is pondering on, or -1
+
+  bool spawn(Side side, const string &opening);
+  void shutdown();
+  bool send(const string &line);
+  bool readLine(int timeoutMs, string *line);
+};
+
+// a Player of this build
+class InternalEngine : public MatchEngine {
+public:
+  InternalEngine(const vector<string> &options);
+  ~InternalEngine();
+  bool start(Side side, const string &opening);
+  bool move(const Move *opponentsMove, int msLeft, Move *reply,
+            bool *passed);
+
+private:
+  vector<string> options;
+  Player *player;
+};
+
+struct EngineSpec {
+  bool internal;
+  vector<string> words; // the command line, or the options
+};
+
+struct GameResult {
+  int discs; // black's discs minus white's
+  int loser; // side that lost by forfeit, or -1
+  string reason; // why it forfeited
+  GameRecord record; // the moves and clocks; the rest is left to the caller
+};
+
+static vector<string> splitWords(const string &text)
+{
+  vector<string> words;
+  size_t i = 0;
+  while (i < text.size())
+  {
+    while (i < text.size() && text[i] == ' ') {i++;}
+    size_t start = i;
+    while (i < text.size() && text[i] != ' ') {i++;}
+    if (i > start)
+    {
+      words.push_back(text.substr(start, i - start));
+    }
+  }
+  return words;
+}
+
+static string squareName(int square)
+{
+  string name;
+  name += (char) ('a' + (square & 7));
+  name += (char) ('1' + (square >> 3));
+  return name;
+}
+
+ProgramEngine::ProgramEngine(const vector<string> &command)
+{
+  this->command = command;
+  extended = false;
+  for (size_t i = 0; i + 1 < command.size(); i++)
+  {
+    extended = extended || (command[i] == "-protocol"
+                         && command[i + 1] == "extended");
+  }
+  pid = -1;
+  input = -1;
+  output = -1;
+  ponderSquare = -1;
+}
+
+ProgramEngine::~ProgramEngine()
+{
+  shutdown();
+}
+
+bool ProgramEngine::start(Side side, const string &opening)
+{
+  ponderSquare = -1;
+  if (!extended || pid <= 0)
+  {
+    shutdown();
+    return spawn(side, opening);
+  }
+  string line;
+  if (!send(string("newgame ") + ((side == BLACK) ? "black" : "white") + " "
+            + opening) || !readLine(INIT_TIMEOUT_MS, &line) || line != "ready")
+  {
+    error = "did not start a new game";
+    shutdown();
+    return false;
+  }
+  return true;
+}
+
+bool ProgramEngine::move(const Move *opponentsMove, int msLeft, Move *reply,
+                         bool *passed)
+{
+  char request[64];
+  if (extended && opponentsMove != nullptr
+   && opponentsMove->square == ponderSquare)
+  {
+    snprintf(request, sizeof(request), "ponderhit %d", msLeft);
+  }
+  else
+  {
+    snprintf(request, sizeof(request), "%s%d %d %d",
+             extended ? "move " : "",
+             opponentsMove ? opponentsMove->getX() : -1,
+             opponentsMove ? opponentsMove->getY() : -1, msLeft);
+  }
+  if (!send(request))
+  {
+    shutdown();
+    return false;
+  }
+  // one extra millisecond, so that running out of time is seen as such
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  string line;
+  while (true)
+  {
+    int elapsed = chrono::duration_cast<chrono::milliseconds>(
+      chrono::steady_clock::now() - start).count();
+    if (!readLine((msLeft < 0) ? -1 : max(0, msLeft + 1 - elapsed), &line))
+    {
+      shutdown();
+      return false;
+    }
+    // the extended protocol's info lines are skipped
+    if (!extended || line.compare(0, 9, "bestmove ") == 0)
+    {
+      break;
+    }
+  }
+  int x, y, ponderX, ponderY;
+  int fields = sscanf(line.c_str() + (extended ? 9 : 0), "%d %d ponder %d %d",
+                      &x, &y, &ponderX, &ponderY);
+  ponderSquare = (fields == 4) ? ponderX + 8 * ponderY : -1;
+  *passed = x < 0 || y < 0;
+  if (fields < 2 || (!*passed && (x > 7 || y > 7)))
+  {
+    error = "sent \"" + line + "\"";
+    shutdown();
+    return false;
+  }
+  *reply = Move(*passed ? 0 : x, *passed ? 0 : y);
+  return true;
+}
+
+// starts the program for a game as side from the opening
+bool ProgramEngine::spawn(Side side, const string &opening)
+{
+  // everything the child needs is prepared before forking, since another
+  // thread may hold the allocator's lock at that moment
+  vector<string> words = command;
+  words.insert(words.begin() + 1, (side == BLACK) ? "Black" : "White");
+  if (!opening.empty())
+  {
+    words.push_back("-opening");
+    words.push_back(opening);
+  }
+  vector<char *> argv;
+  for (size_t i = 0; i < words.size(); i++)
+  {
+    argv.push_back((char *) words[i].c_str());
+  }
+  argv.push_back(nullptr);
+
+  // close-on-exec, so that engines of other games do not inherit them
+  int toChild[2], fromChild[2];
+  if (pipe2(toChild, O_CLOEXEC) != 0)
+  {
+    error = "could not create a pipe";
+    return false;
+  }
+  if (pipe2(fromChild, O_CLOEXEC) != 0)
+  {
+    close(toChild[0]);
+    close(toChild[1]);
+    error = "could not create a pipe";
+    return false;
+  }
+  int devNull = open("/dev/null", O_WRONLY | O_CLOEXEC);
+  pid = fork();
+  if (pid == 0)
+  {
+    dup2(toChild[0], 0);
+    dup2(fromChild[1], 1);
+    if (devNull >= 0)
+    {
+      dup2(devNull, 2);
+    }
+    execvp(argv[0], argv.data());
+    _exit(127);
+  }
+  close(toChild[0]);
+  close(fromChild[1]);
+  if (devNull >= 0)
+  {
+    close(devNull);
+  }
+  input = toChild[1];
+  output = fromChild[0];
+  if (pid < 0)
+  {
+    error = "could not start " + words[0];
+    shutdown();
+    return false;
+  }
+  string line;
+  if (!readLine(INIT_TIMEOUT_MS, &line) || line != "Init done")
+  {
+    error = "did not initialize";
+    shutdown();
+    return false;
+  }
+  return true;
+}
+
+// ends the program, if it is running
+void ProgramEngine::shutdown()
+{
+  if (input >= 0)
+  {
+    close(input); // the wrapper exits at the end of its input
+  }
+  if (pid > 0)
+  {
+    int status;
+    int waited = 0;
+    while (waitpid(pid, &status, WNOHANG) == 0)
+    {
+      if (waited >= QUIT_TIMEOUT_MS)
+      {
+        kill(pid, SIGKILL);
+        waitpid(pid, &status, 0);
+        break;
+      }
+      usleep(10000);
+      waited += 10;
+    }
+  }
+  if (output >= 0)
+  {
+    close(output);
+  }
+  pid = -1;
+  input = -1;
+  output = -1;
+  buffered.clear();
+}
+
+// writes the line and a newline in one write
+bool ProgramEngine::send(const string &line)
+{
+  string data = line + "\n";
+  if (write(input, data.data(), data.size()) != (ssize_t) data.size())
+  {
+    error = "stopped reading its input";
+    return false;
+  }
+  return true;
+}
+
+// reads a line of output without its newline. returns false with an error
+// if the program exits or timeoutMs passes first; -1 waits indefinitely
+bool ProgramEngine::readLine(int timeoutMs, string *line)
+{
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  while (true)
+  {
+    size_t newline = buffered.find('\n');
+    if (newline != string::npos)
+    {
+      *line = buffered.substr(0, newline);
+      buffered.erase(0, newline + 1);
+      return true;
+    }
+    int wait = -1;
+    if (timeoutMs >= 0)
+    {
+      int elapsed = chrono::duration_cast<chrono::milliseconds>(
+        chrono::steady_clock::now() - start).count();
+      wait = max(0, timeoutMs - elapsed);
+    }
+    struct pollfd fd = {output, POLLIN, 0};
+    int ready = poll(&fd, 1, wait);
+    if (ready == 0)
+    {
+      error = "ran out of time";
+      return false;
+    }
+    char data[4096];
+    ssize_t got = (ready > 0) ? read(output, data, sizeof(data)) : -1;
+    if (got <= 0)
+    {
+      error = "exited";
+      return false;
+    }
+    buffered.append(data, got);
+  }
+}
+
+InternalEngine::InternalEngine(const vector<string> &options)
+{
+  this->options = options;
+  player = nullptr;
+}
+
+InternalEngine::~InternalEngine()
+{
+  delete player;
+}
+
+bool InternalEngine::start(Side side, const string &opening)
+{
+  if (player != nullptr)
+  {
+    player->newGame(side);
+  }
+  else
+  {
+    player = new Player(side);
+  }
+  for (size_t i = 0; i + 1 < options.size(); i += 2)
+  {
+    const char *value = options[i + 1].c_str();
+    if (options[i] == "-hash")
+    {
+      player->setHashSize(atoi(value));
+    }
+    else if (options[i] == "-threads")
+    {
+      player->threads = atoi(value);
+    }
+    else if (options[i] == "-probcut")
+    {
+      player->probcut.enabled = atoi(value) != 0;
+    }
+    else if (options[i] == "-probcut-threshold")
+    {
+      player->probcut.threshold = atof(value);
+    }
+    else if (options[i] == "-ponder")
+    {
+      player->ponder = atoi(value) != 0;
+    }
+    else if (options[i] == "-tree")
+    {
+      player->useTree = atoi(value) != 0;
+    }
+    else
+    {
+      error = "unknown option " + options[i];
+      return false;
+    }
+  }
+  Side toMove = BLACK;
+  for (size_t i = 0; i + 1 < opening.size(); i += 2)
+  {
+    Move m(opening[i] - 'a', opening[i + 1] - '1');
+    player->board.doMove(&m, toMove);
+    toMove = flip(toMove);
+  }
+  return true;
+}
+
+bool InternalEngine::move(const Move *opponentsMove, int msLeft, Move *reply,
+                          bool *passed)
+{
+  Move opponents = opponentsMove ? *opponentsMove : Move();
+  Move *chosen = player->doMove(opponentsMove ? &opponents : nullptr,
+                                msLeft);
+  *passed = chosen == nullptr;
+  if (chosen != nullptr)
+  {
+    *reply = *chosen;
+    delete chosen;
+  }
+  return true;
+}
+
+static MatchEngine *makeEngine(const EngineSpec &spec)
+{
+  if (spec.internal)
+  {
+    return new InternalEngine(spec.words);
+  }
+  return new ProgramEngine(spec.words);
+}
+
+// plays out one game under OthelloGame's rules
+static GameResult playGame(MatchEngine *black, MatchEngine *white,
+                           const string &opening, int ms)
+{
+  GameResult result;
+  result.discs = 0;
+  result.loser = -1;
+  memset(&result.record.header, 0, sizeof(RecordHeader));
+  RecordHeader &header = result.record.header;
+  MatchEngine *engines[2] = {white, black}; // indexed by Side
+  Board board;
+  Side side = BLACK;
+  for (size_t i = 0; i + 1 < opening.size(); i += 2)
+  {
+    Move m(opening[i] - 'a', opening[i + 1] - '1');
+    board.doMove(&m, side);
+    result.record.moves[header.plies++] = m.square;
+    side = flip(side);
+  }
+  for (int s = 0; s < 2; s++)
+  {
+    if (!engines[s]->start((Side) s, opening))
+    {
+      result.loser = s;
+      result.reason = engines[s]->error;
+      return result;
+    }
+  }
+  long long clock[2] = {ms, ms};
+  Move last;
+  bool lastPassed = true;
+  while (!board.isDone())
+  {
+    Move reply;
+    bool passed = false;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    bool ok = engines[side]->move(lastPassed ? nullptr : &last,
+                                  (ms > 0) ? (int) clock[side] : -1,
+                                  &reply, &passed);
+    int used = chrono::duration_cast<chrono::milliseconds>(
+      chrono::steady_clock::now() - start).count();
+    clock[side] -= used;
+    header.ms[side] += used;
+    if (!ok || (ms > 0 && clock[side] < 0))
+    {
+      result.loser = side;
+      result.reason = ok ? "ran out of time" : engines[side]->error;
+      return result;
+    }
+    if (passed ? board.hasMoves(side) : !board.checkMove(&reply, side))
+    {
+      result.loser = side;
+      result.reason = "played the illegal move "
+                    + (passed ? string("pass") : squareName(reply.square));
+      return result;
+    }
+    if (!passed)
+    {
+      board.doMove(&reply, side);
+    }
+    result.record.moves[header.plies++] = passed ? NO_MOVE : reply.square;
+    last = reply;
+    lastPassed = passed;
+    side = flip(side);
+  }
+  result.discs = board.countBlack() - board.countWhite();
+  return result;
+}
+
+// random openings of the given length with no passes, as move text
+static vector<string> makeOpenings(int count, int plies, unsigned seed)
+{
+  mt19937 generator(seed);
+  vector<string> openings;
+  while ((int) openings.size() < count)
+  {
+    Board board;
+    Side side = BLACK;
+    string text;
+    for (int ply = 0; ply < plies; ply++)
+    {
+      uint64_t legal = board.legalMoves(side);
+      if (legal == 0)
+      {
+        break;
+      }
+      for (int k = generator() % __builtin_popcountll(legal); k > 0; k--)
+      {
+        legal &= legal - 1;
+      }
+      int square = __builtin_ctzll(legal);
+      board.makeMove(square, side);
+      side = flip(side);
+      text += squareName(square);
+    }
+    if ((int) text.size() == 2 * plies)
+    {
+      openings.push_back(text);
+    }
+  }
+  return openings;
+}
+
+// Elo difference for a score fraction
+static double elo(double score)
+{
+  score = min(max(score, 1e-6), 1 - 1e-6);
+  return 400 * log10(score / (1 - score));
+}
+
+static bool parseEngine(const char *text, EngineSpec *spec)
+{
+  spec->words = splitWords(text);
+  spec->internal = !spec->words.empty() && spec->words[0] == "internal";
+  if (spec->internal)
+  {
+    spec->words.erase(spec->words.begin());
+  }
+  return spec->internal || !spec->words.empty();
+}
+
+int main(int argc, char *argv[])
+{
+  int games = DEFAULT_MATCH_GAMES;
+  int concurrency = max(1, (int) thread::hardware_concurrency());
+  int threads = 1;
+  int ms = DEFAULT_MATCH_MS;
+  int plies = DEFAULT_OPENING_PLIES;
+  unsigned seed = 1;
+  const char *recordPath = nullptr;
+  int i = 1;
+  bool ok = true;
+  for (; ok && i + 1 < argc && argv[i][0] == '-'; i += 2)
+  {
+    int value = atoi(argv[i + 1]);
+    if (!strcmp(argv[i], "-games")) {games = value; ok = value > 0;}
+    else if (!strcmp(argv[i], "-concurrency"))
+    {
+      concurrency = value;
+      ok = value > 0;
+    }
+    else if (!strcmp(argv[i], "-threads")) {threads = value; ok = value > 0;}
+    else if (!strcmp(argv[i], "-time")) {ms = value; ok = value >= 0;}
+    else if (!strcmp(argv[i], "-openings"))
+    {
+      plies = value;
+      ok = value >= 0 && value <= 20;
+    }
+    else if (!strcmp(argv[i], "-seed")) {seed = value;}
+    else if (!strcmp(argv[i], "-record")) {recordPath = argv[i + 1];}
+    else {ok = false;}
+  }
+  EngineSpec specs[2];
+  if (!ok || argc - i != 2 || !parseEngine(argv[i], &specs[0])
+   || !parseEngine(argv[i + 1], &specs[1]))
+  {
+    fprintf(stderr, "usage: %s [-games N] [-concurrency N] [-threads N] "
+                    "[-time MS] [-openings PLIES] [-seed N] [-record FILE] "
+                    "ENGINE1 ENGINE2\n", argv[0]);
+    return 1;
+  }
+  for (int e = 0; e < 2; e++)
+  {
+    // after the program's name, where the side goes
+    vector<string>::iterator at = specs[e].words.begin()
+                                + (specs[e].internal ? 0 : 1);
+    string words[2] = {"-threads", to_string(threads)};
+    specs[e].words.insert(at, words, words + 2);
+  }
+  RecordWriter records;
+  if (recordPath != nullptr && !records.open(recordPath))
+  {
+    fprintf(stderr, "could not write %s\n", recordPath);
+    return 1;
+  }
+  // a program that exits early must not take the runner with it
+  signal(SIGPIPE, SIG_IGN);
+
+  vector<string> openings = makeOpenings((games + 1) / 2, plies, seed);
+  // from ENGINE1's point of view
+  int wins = 0, losses = 0, draws = 0;
+  int forfeits[2] = {0, 0};
+  long long discs = 0;
+  int played = 0;
+  atomic<int> next(0);
+  mutex lock;
+  vector<thread> workers;
+  for (int w = 0; w < min(concurrency, games); w++)
+  {
+    workers.push_back(thread([&]() {
+      // each worker keeps its engines for all of its games
+      MatchEngine *engines[2] = {makeEngine(specs[0]), makeEngine(specs[1])};
+      for (int g = next++; g < games; g = next++)
+      {
+        // ENGINE1 is black in even games and white in odd ones
+        int first = g % 2;
+        MatchEngine *black = engines[first];
+        MatchEngine *white = engines[1 - first];
+        GameResult r = playGame(black, white, openings[g / 2], ms);
+        RecordHeader &header = r.record.header;
+        header.engine[BLACK] = first + 1;
+        header.engine[WHITE] = 2 - first;
+        header.margin = r.discs;
+        if (r.loser >= 0)
+        {
+          header.flags |= RECORD_FORFEIT;
+          header.margin = (r.loser == BLACK) ? -64 : 64;
+        }
+
+        // the result for ENGINE1
+        int margin = (first == 0) ? r.discs : -r.discs;
+        int forfeiter = -1;
+        if (r.loser >= 0)
+        {
+          forfeiter = (r.loser == BLACK) ? first : 1 - first;
+          margin = (forfeiter == 0) ? -64 : 64;
+        }
+        lock_guard<mutex> guard(lock);
+        played++;
+        if (margin > 0) {wins++;}
+        else if (margin < 0) {losses++;}
+        else {draws++;}
+        discs += margin;
+        if (recordPath != nullptr)
+        {
+          records.write(r.record);
+        }
+        if (forfeiter >= 0)
+        {
+          forfeits[forfeiter]++;
+          fprintf(stderr, "\ngame %d: ENGINE%d %s\n", g + 1, forfeiter + 1,
+                  r.reason.c_str());
+        }
+        fprintf(stderr, "\r%d/%d games: +%d -%d =%d", played, games, wins,
+                losses, draws);
+      }
+      delete engines[0];
+      delete engines[1];
+    }));
+  }
+  for (size_t w = 0; w < workers.size(); w++)
+  {
+    workers[w].join();
+  }
+  fprintf(stderr, "\n");
+  if (recordPath != nullptr && !records.close())
+  {
+    fprintf(stderr, "could not write %s\n", recordPath);
+  }
+
+  // the Elo interval comes from the spread of the per-game scores
+  double n = played;
+  double score = (wins + 0.5 * draws) / n;
+  double variance = (wins * (1 - score) * (1 - score)
+                   + draws * (0.5 - score) * (0.5 - score)
+                   + losses * score * score) / n;
+  double margin95 = 1.96 * sqrt(variance / n);
+  double low = elo(score - margin95);
+  double high = elo(score + margin95);
+  printf("games %d: ENGINE1 +%d -%d =%d, score %.1f%%, "
+         "average disc margin %+.2f\n", played, wins, losses, draws,
+         100 * score, discs / n);
+  printf("forfeits: ENGINE1 %d, ENGINE2 %d\n", forfeits[0], forfeits[1]);
+  if (wins == played || losses == played)
+  {
+    printf("Elo difference: unbounded, one engine won every game\n");
+  }
+  else
+  {
+    printf("Elo difference: %+.1f +/- %.1f (95%%: %+.1f to %+.1f)\n",
+           elo(score), (high - low) / 2, low, high);
+  }
+  return 0;
+}
@@ -0,0 +1,348 @@
+// Offline tool for the Multi-ProbCut parameters of the Othello AI.
+//
+//   mpctool fit POSITIONS MAXDEPTH [FILE]
+//     searches POSITIONS generated midgame positions full-width to every
+//     depth up to MAXDEPTH, fits the deep = a * shallow + b regressions per
+//     phase and depth, writes them to FILE (default othello.probcut) and
+//     prints them as the table for probcut.cpp
+//   mpctool test POSITIONS DEPTH [THRESHOLD [FILE]]
+//     measures the prediction error of the parameters in FILE (default: the
+//     built-in ones) on a different set of positions, then compares a
+//     DEPTH-ply search with ProbCut at THRESHOLD against a full-width one:
+//     how often the move differs, how often it is a blunder, and how many
+//     nodes it saves
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <chrono>
+#include "board.hpp"
+#include "search.hpp"
+#include "eval.hpp"
+#include "probcut.hpp"
+using namespace std;
+
+const int MIN_EMPTIES = 21; // below this the endgame solver takes over
+const int MAX_EMPTIES = 54;
+const int RANDOM_MOVE_PERCENT = 30;
+const int BLUNDER_DISCS = 2; // losing this much against the full-width
+                             // search's best move counts as a blunder
+const int TT_MB = 16;
+const unsigned FIT_SEED = 1;
+const unsigned TEST_SEED = 1000001;
+
+// sums for fitting y = a * x + b
+struct Regression {
+  double n, sx, sy, sxx, sxy, syy;
+};
+
+// plays a game from the start, mostly with 2-ply searches and sometimes at
+// random, until the given number of squares is empty. returns false if the
+// game ended first
+static bool randomPosition(const Evaluator &eval, int empties, Board *board,
+                           Side *side)
+{
+  *board = Board();
+  *side = BLACK;
+  while (board->countEmpty() > empties)
+  {
+    uint64_t legal = board->legalMoves(*side);
+    if (legal == 0)
+    {
+      if (board->legalMoves(flip(*side)) == 0)
+      {
+        return false;
+      }
+      *side = flip(*side);
+      continue;
+    }
+    int square;
+    if (rand() % 100 < RANDOM_MOVE_PERCENT)
+    {
+      for (int k = rand() % __builtin_popcountll(legal); k > 0; k--)
+      {
+        legal &= legal - 1;
+      }
+      square = __builtin_ctzll(legal);
+    }
+    else
+    {
+      Search search(nullptr, &eval);
+      Move best;
+      search.iterativeDeepening(*board, *side, 2, nullptr, &best);
+      square = best.square;
+    }
+    board->makeMove(square, *side);
+    *side = flip(*side);
+  }
+  return board->legalMoves(*side) != 0;
+}
+
+static bool nextPosition(const Evaluator &eval, Board *board, Side *side)
+{
+  int empties = MIN_EMPTIES + rand() % (MAX_EMPTIES - MIN_EMPTIES + 1);
+  for (int tries = 0; tries < 100; tries++)
+  {
+    if (randomPosition(eval, empties, board, side))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+// full-width scores of the position at every depth up to maxDepth
+static void scoreDepths(const Evaluator &eval, TranspositionTable &tt,
+                        const Board &board, Side side, int maxDepth,
+                        int scores[])
+{
+  tt.clear();
+  Search search(&tt, &eval);
+  Move best;
+  for (int depth = 1; depth <= maxDepth; depth++)
+  {
+    scores[depth] = search.searchRoot(board, side, depth, &best);
+  }
+}
+
+// full-width score for side of playing square, searched to depth
+static int moveScore(const Evaluator &eval, TranspositionTable &tt,
+                     const Board &board, Side side, int square, int depth)
+{
+  Board child = board;
+  child.makeMove(square, side);
+  Search search(&tt, &eval);
+  Move best;
+  if (child.legalMoves(flip(side)) != 0)
+  {
+    if (depth == 1)
+    {
+      return -eval.evaluate(child, flip(side));
+    }
+    return -search.searchRoot(child, flip(side), depth - 1, &best);
+  }
+  if (child.legalMoves(side) != 0)
+  {
+    // the opponent passes, which does not use up depth
+    return search.searchRoot(child, side, max(1, depth - 1), &best);
+  }
+  return (child.count(side) - child.count(flip(side))) * DISC_WIN_SCALE;
+}
+
+static int fit(int positions, int maxDepth, const char *path)
+{
+  Evaluator eval;
+  eval.load(DEFAULT_WEIGHTS_FILE);
+  TranspositionTable tt(TT_MB);
+  vector<Regression> sums(MPC_PHASES * (MPC_MAX_DEPTH + 1), Regression());
+  srand(FIT_SEED);
+  int scores[MPC_MAX_DEPTH + 1];
+  for (int i = 0; i < positions; i++)
+  {
+    Board board;
+    Side side;
+    if (!nextPosition(eval, &board, &side))
+    {
+      continue;
+    }
+    int phase = ProbCut::phaseOf(board);
+    scoreDepths(eval, tt, board, side, maxDepth, scores);
+    for (int depth = MPC_MIN_DEPTH; depth <= maxDepth; depth++)
+    {
+      Regression &r = sums[phase * (MPC_MAX_DEPTH + 1) + depth];
+      double x = scores[ProbCut::shallowDepth(depth)];
+      double y = scores[depth];
+      r.n++; r.sx += x; r.sy += y; r.sxx += x * x; r.sxy += x * y;
+      r.syy += y * y;
+    }
+    fprintf(stderr, "\r%d/%d positions", i + 1, positions);
+  }
+  fprintf(stderr, "\n");
+
+  ProbCut probcut;
+  printf("const int MPC_FITTED_DEPTH = %d;\n", maxDepth);
+  printf("static const float DEFAULT_FIT[MPC_PHASES][MPC_FITTED_DEPTH - "
+         "MPC_MIN_DEPTH\n                                           + 1][3] "
+         "= {\n");
+  for (int phase = 0; phase < MPC_PHASES; phase++)
+  {
+    printf("  {\n");
+    for (int depth = MPC_MIN_DEPTH; depth <= MPC_MAX_DEPTH; depth++)
+    {
+      ProbCutRegression &out = probcut.table[phase][depth];
+      if (depth > maxDepth)
+      {
+        // nothing measured this deep; reuse the deepest fit of the same
+        // parity
+        out = probcut.table[phase][maxDepth - ((depth - maxDepth) & 1)];
+        out.shallow = ProbCut::shallowDepth(depth);
+        continue;
+      }
+      Regression &r = sums[phase * (MPC_MAX_DEPTH + 1) + depth];
+      double varX = r.n * r.sxx - r.sx * r.sx;
+      if (r.n < 3 || varX <= 0)
+      {
+        out.sigma = 0; // too few samples: never cut
+      }
+      else
+      {
+        double a = (r.n * r.sxy - r.sx * r.sy) / varX;
+        double b = (r.sy - a * r.sx) / r.n;
+        // residual sum of squares of the fitted line
+        double rss = r.syy - 2 * a * r.sxy - 2 * b * r.sy + a * a * r.sxx
+                   + 2 * a * b * r.sx + b * b * r.n;
+        out.a = (float) a;
+        out.b = (float) b;
+        out.sigma = (float) sqrt(max(0.0, rss / (r.n - 2)));
+      }
+      printf("    {%.3ff, %.1ff, %.1ff},\n", out.a, out.b, out.sigma);
+    }
+    printf("  },\n");
+  }
+  printf("};\n");
+  if (!probcut.save(path))
+  {
+    fprintf(stderr, "could not write %s\n", path);
+    return 1;
+  }
+  return 0;
+}
+
+static int test(int positions, int depth, double threshold,
+                const char *path)
+{
+  Evaluator eval;
+  eval.load(DEFAULT_WEIGHTS_FILE);
+  ProbCut probcut;
+  if (path != nullptr && !probcut.load(path))
+  {
+    fprintf(stderr, "could not read %s\n", path);
+    return 1;
+  }
+  probcut.threshold = threshold;
+  TranspositionTable tt(TT_MB);
+  srand(TEST_SEED);
+  vector<double> errorSum(depth + 1, 0.0), errorSquares(depth + 1, 0.0);
+  vector<int> samples(depth + 1, 0);
+  long long fullNodes = 0, cutNodes = 0;
+  double fullTime = 0, cutTime = 0;
+  int tested = 0, differ = 0, blunders = 0;
+  double loss = 0;
+  int scores[MPC_MAX_DEPTH + 1];
+  for (int i = 0; i < positions; i++)
+  {
+    Board board;
+    Side side;
+    if (!nextPosition(eval, &board, &side))
+    {
+      continue;
+    }
+    // how far the regression's predictions are off
+    int phase = ProbCut::phaseOf(board);
+    scoreDepths(eval, tt, board, side, depth, scores);
+    for (int d = MPC_MIN_DEPTH; d <= depth; d++)
+    {
+      const ProbCutRegression *r = probcut.regression(phase, d);
+      if (r != nullptr)
+      {
+        double error = scores[d] - (r->a * scores[r->shallow] + r->b);
+        errorSum[d] += fabs(error);
+        errorSquares[d] += error * error;
+        samples[d]++;
+      }
+    }
+
+    // the same search with and without ProbCut
+    Move fullMove, cutMove;
+    tt.clear();
+    Search full(&tt, &eval);
+    auto start = chrono::steady_clock::now();
+    int fullScore = full.iterativeDeepening(board, side, depth, nullptr,
+                                            &fullMove);
+    auto middle = chrono::steady_clock::now();
+    tt.clear();
+    Search cut(&tt, &eval, &probcut);
+    cut.iterativeDeepening(board, side, depth, nullptr, &cutMove);
+    auto end = chrono::steady_clock::now();
+    fullNodes += full.nodes;
+    cutNodes += cut.nodes;
+    fullTime += chrono::duration<double>(middle - start).count();
+    cutTime += chrono::duration<double>(end - middle).count();
+    tested++;
+    if (cutMove.square != fullMove.square)
+    {
+      differ++;
+      tt.clear();
+      int lost = fullScore - moveScore(eval, tt, board, side, cutMove.square,
+                                       full.completedDepth);
+      loss += max(0, lost);
+      if (lost >= BLUNDER_DISCS * DISC_WIN_SCALE)
+      {
+        blunders++;
+      }
+    }
+    fprintf(stderr, "\r%d/%d positions", i + 1, positions);
+  }
+  fprintf(stderr, "\n");
+
+  printf("prediction error in discs (mean absolute, rms):\n");
+  for (int d = MPC_MIN_DEPTH; d <= depth; d++)
+  {
+    if (samples[d] > 0)
+    {
+      printf("  depth %2d from %2d: %6.2f %6.2f\n", d,
+             ProbCut::shallowDepth(d),
+             errorSum[d] / samples[d] / DISC_WIN_SCALE,
+             sqrt(errorSquares[d] / samples[d]) / DISC_WIN_SCALE);
+    }
+  }
+  if (tested == 0)
+  {
+    return 1;
+  }
+  printf("depth %d, threshold %.2f, %d positions\n", depth,
+         probcut.threshold, tested);
+  printf("  different move: %.1f%%\n", 100.0 * differ / tested);
+  printf("  blunders (>= %d discs): %.1f%%\n", BLUNDER_DISCS,
+         100.0 * blunders / tested);
+  printf("  mean loss: %.3f discs\n", loss / tested / DISC_WIN_SCALE);
+  printf("  nodes: %lld full width, %lld with ProbCut (%.1f%%)\n", fullNodes,
+         cutNodes, 100.0 * cutNodes / fullNodes);
+  printf("  time: %.2fs full width, %.2fs with ProbCut\n", fullTime,
+         cutTime);
+  return 0;
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc >= 4 && !strcmp(argv[1], "fit"))
+  {
+    int maxDepth = atoi(argv[3]);
+    if (maxDepth < MPC_MIN_DEPTH || maxDepth > MPC_MAX_DEPTH)
+    {
+      fprintf(stderr, "depth must be between %d and %d\n", MPC_MIN_DEPTH,
+              MPC_MAX_DEPTH);
+      return 1;
+    }
+    return fit(atoi(argv[2]), maxDepth,
+               (argc >= 5) ? argv[4] : DEFAULT_PROBCUT_FILE);
+  }
+  if (argc >= 4 && !strcmp(argv[1], "test"))
+  {
+    int depth = atoi(argv[3]);
+    if (depth < 1 || depth > MPC_MAX_DEPTH)
+    {
+      fprintf(stderr, "depth must be between 1 and %d\n", MPC_MAX_DEPTH);
+      return 1;
+    }
+    return test(atoi(argv[2]), depth,
+                (argc >= 5) ? atof(argv[4]) : MPC_DEFAULT_THRESHOLD,
+                (argc >= 6) ? argv[5] : nullptr);
+  }
+  fprintf(stderr, "usage: %s fit POSITIONS MAXDEPTH [FILE]\n"
+                  "       %s test POSITIONS DEPTH [THRESHOLD [FILE]]\n",
+          argv[0], argv[0]);
+  return 1;
+}
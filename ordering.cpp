@@ -0,0 +1,94 @@
+// Move ordering tables for the Othello AI
+
+#include "ordering.hpp"
+#include <cstring>
+using namespace std;
+
+const int KILLER1_KEY = 1 << 26;
+const int KILLER2_KEY = 1 << 25;
+const int PRIORITY_WEIGHT = 1 << 13;
+const int HISTORY_MAX = 1 << 16; // the table is halved once any entry gets
+                                 // this big, so old cutoffs fade out and the
+                                 // keys stay below the killers
+
+// rough value of each square regardless of the position: corners are best,
+// the squares next to a corner give it away and go last
+static const int SQUARE_PRIORITY[64] = {
+  8, 2, 7, 6, 6, 7, 2, 8,
+  2, 0, 3, 4, 4, 3, 0, 2,
+  7, 3, 5, 5, 5, 5, 3, 7,
+  6, 4, 5, 5, 5, 5, 4, 6,
+  6, 4, 5, 5, 5, 5, 4, 6,
+  7, 3, 5, 5, 5, 5, 3, 7,
+  2, 0, 3, 4, 4, 3, 0, 2,
+  8, 2, 7, 6, 6, 7, 2, 8
+};
+
+MoveOrdering::MoveOrdering()
+{
+  clear();
+}
+
+void MoveOrdering::clear()
+{
+  memset(killers, NO_MOVE, sizeof(killers));
+  memset(history, 0, sizeof(history));
+}
+
+void MoveOrdering::recordCutoff(Side side, int ply, int depth, int square)
+{
+  if (ply < MAX_PLY && killers[ply][0] != square)
+  {
+    killers[ply][1] = killers[ply][0];
+    killers[ply][0] = square;
+  }
+  // deep cutoffs say more about a move than shallow ones
+  history[side][square] += depth * depth;
+  if (history[side][square] >= HISTORY_MAX)
+  {
+    for (int s = 0; s < 2; s++)
+    {
+      for (int i = 0; i < 64; i++)
+      {
+        history[s][i] /= 2;
+      }
+    }
+  }
+}
+
+int MoveOrdering::quietScore(Side side, int ply, int square) const
+{
+  int key = history[side][square]
+          + SQUARE_PRIORITY[square] * PRIORITY_WEIGHT;
+  if (ply < MAX_PLY)
+  {
+    if (killers[ply][0] == square)
+    {
+      key += KILLER1_KEY;
+    }
+    else if (killers[ply][1] == square)
+    {
+      key += KILLER2_KEY;
+    }
+  }
+  return key;
+}
+
+void sortMoves(int moves[], int keys[], int count)
+{
+  // insertion sort; there are rarely more than a dozen moves
+  for (int j = 1; j < count; j++)
+  {
+    int move = moves[j];
+    int key = keys[j];
+    int i = j;
+    while (i > 0 && keys[i - 1] < key)
+    {
+      keys[i] = keys[i - 1];
+      moves[i] = moves[i - 1];
+      i--;
+    }
+    keys[i] = key;
+    moves[i] = move;
+  }
+}
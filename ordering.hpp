@@ -0,0 +1,39 @@
+#ifndef __ORDERING_H__
+#define __ORDERING_H__
+
+#include "common.hpp"
+#include "board.hpp"
+
+// Move ordering for the negamax search. Alpha-beta prunes the most when the
+// best move is searched first, so before a node is searched its moves are
+// sorted by how promising they look: the move the transposition table (or
+// the previous iteration) found best, then the killer moves that refuted a
+// sibling position at the same ply, then everything else by history score,
+// square priority and how few replies the move leaves the opponent.
+
+using namespace std;
+
+const int MAX_PLY = 128; // passes add plies without using up depth
+const int MAX_MOVES = 64;
+const int NO_MOVE = 64;
+
+class MoveOrdering {
+public:
+  MoveOrdering();
+  // forgets all killers and history
+  void clear();
+  // records that square caused a beta cutoff for side at this ply
+  void recordCutoff(Side side, int ply, int depth, int square);
+  // ordering key of a move from killers, history and square priority only.
+  // higher keys are searched first
+  int quietScore(Side side, int ply, int square) const;
+
+private:
+  uint8_t killers[MAX_PLY][2];
+  int history[2][64];
+};
+
+// sorts moves[0..count) by descending keys[], keeping equal keys in order
+void sortMoves(int moves[], int keys[], int count);
+
+#endif
@@ -0,0 +1,360 @@
+// Move generation test and benchmark for the Othello AI.
+//
+//   perft [-kernel auto|scalar|avx2] [DEPTH]
+//     counts the leaf nodes DEPTH plies (default 9) below the start
+//     position, and below each of the built-in test positions, and checks
+//     the counts against the known ones. positions are only searched as
+//     deep as their counts are known
+//   perft [-kernel auto|scalar|avx2] DEPTH FILE
+//     does the same for the positions in FILE, one per line: the 64 squares
+//     in setBoard order ('b', 'w', or anything else for an empty square),
+//     the side to move ('b' or 'w'), and optionally the expected counts at
+//     depths 1, 2, 3, ...
+//   perft kernels [POSITIONS]
+//     times legalMoves and, separately, mobility on POSITIONS (default
+//     1000000) positions from random games with every move generation
+//     kernel the CPU can run, and checks that the kernels give the same
+//     moves and mobility
+//
+// -kernel picks the move generation kernel (see Board's setMoveKernel);
+// the default is the one the player would use.
+// A pass counts as a ply, and a finished game is a leaf at any depth. The
+// last ply is counted from the legal move mask without being played.
+// Prints the count and nodes per second for every depth, and exits with
+// status 1 if any count is wrong.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include "board.hpp"
+using namespace std;
+
+const int MAX_PERFT_DEPTH = 20;
+const int DEFAULT_PERFT_DEPTH = 9;
+const int DEFAULT_KERNEL_POSITIONS = 1000000;
+const int KERNEL_ROUNDS = 20;
+
+struct PerftPosition {
+  string name;
+  char squares[64];
+  Side side;
+  vector<long long> expected; // expected[d - 1] is the count at depth d
+};
+
+// from the start position
+static const long long START_COUNTS[] = {
+  4, 12, 56, 244, 1396, 8200, 55092, 390216, 3005288, 24571284, 212258800
+};
+
+// more positions from random games, with their counts at depths 1 to 6 as
+// found by the original array-based board
+static const struct {
+  const char *name;
+  const char *squares;
+  char side;
+  long long counts[6];
+} TEST_POSITIONS[] = {
+  {"opening",
+   "---------b---w----b-w----b-www----bww-b--wbwbb----wwb-----------",
+   'b', {11, 142, 1571, 20714, 240880, 3197682}},
+  {"midgame",
+   "-----bw--wb-wbbb--wbbwb-b-bwb-b--bbwbbb--www-bb--www--bb--------",
+   'b', {16, 223, 3353, 46376, 656038, 8969630}},
+  {"endgame",
+   "w-w-bbb--ww--wbb-bwb-wbb-bwwbwbbbbwbbwbb-bbwbbbbbbbbbw-bww-w----",
+   'b', {9, 100, 702, 7061, 41850, 374531}},
+  {"white passes and the game ends",
+   "bbbwwwwwbbbbwwwbbwbbbbbbbbbbwwbbbwwwbbwbb-wbwwwb-wwwwbbb-bbbbbbb",
+   'w', {1, 3, 5, 5, 5, 5}},
+};
+
+static long long perft(const Board &board, Side side, int depth)
+{
+  uint64_t legal = board.legalMoves(side);
+  if (legal == 0)
+  {
+    if (!board.hasMoves(flip(side)))
+    {
+      return 1; // the game is over
+    }
+    return (depth == 1) ? 1 : perft(board, flip(side), depth - 1);
+  }
+  if (depth == 1)
+  {
+    return __builtin_popcountll(legal);
+  }
+  long long nodes = 0;
+  while (legal != 0)
+  {
+    Board child = board;
+    child.makeMove(__builtin_ctzll(legal), side);
+    nodes += perft(child, flip(side), depth - 1);
+    legal &= legal - 1;
+  }
+  return nodes;
+}
+
+// counts every depth up to maxDepth and compares against the expected
+// counts, where there are any. returns false on a mismatch
+static bool run(const PerftPosition &position, int maxDepth)
+{
+  Board board;
+  board.setBoard((char *) position.squares);
+  printf("%s\n", position.name.c_str());
+  bool ok = true;
+  for (int depth = 1; depth <= maxDepth; depth++)
+  {
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    long long nodes = perft(board, position.side, depth);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now()
+                                              - start).count();
+    printf("  perft(%2d) = %12lld  %8.3f s  %8.2f Mnodes/s", depth, nodes,
+           seconds, (seconds > 0) ? nodes / seconds / 1e6 : 0.0);
+    if (depth <= (int) position.expected.size())
+    {
+      long long expected = position.expected[depth - 1];
+      if (nodes == expected)
+      {
+        printf("  ok");
+      }
+      else
+      {
+        printf("  WRONG, expected %lld", expected);
+        ok = false;
+      }
+    }
+    printf("\n");
+  }
+  return ok;
+}
+
+// parses a line of a positions file. returns false if it is not a position
+static bool parsePosition(const char *line, PerftPosition *position)
+{
+  if (strlen(line) < 66 || line[64] != ' '
+   || (line[65] != 'b' && line[65] != 'w'))
+  {
+    return false;
+  }
+  memcpy(position->squares, line, 64);
+  position->side = (line[65] == 'b') ? BLACK : WHITE;
+  position->expected.clear();
+  char *end = (char *) line + 66;
+  while (true)
+  {
+    char *next;
+    long long count = strtoll(end, &next, 10);
+    if (next == end)
+    {
+      break;
+    }
+    position->expected.push_back(count);
+    end = next;
+  }
+  return true;
+}
+
+static vector<PerftPosition> builtinPositions()
+{
+  vector<PerftPosition> positions;
+  PerftPosition start;
+  start.name = "start position";
+  Board initial;
+  for (int i = 0; i < 64; i++)
+  {
+    uint64_t bit = 1ULL << i;
+    start.squares[i] = (initial.discs(BLACK) & bit) ? 'b'
+                     : (initial.discs(WHITE) & bit) ? 'w' : '-';
+  }
+  start.side = BLACK;
+  start.expected.assign(START_COUNTS, START_COUNTS
+                        + sizeof(START_COUNTS) / sizeof(START_COUNTS[0]));
+  positions.push_back(start);
+  for (size_t i = 0; i < sizeof(TEST_POSITIONS) / sizeof(TEST_POSITIONS[0]);
+       i++)
+  {
+    PerftPosition p;
+    p.name = TEST_POSITIONS[i].name;
+    memcpy(p.squares, TEST_POSITIONS[i].squares, 64);
+    p.side = (TEST_POSITIONS[i].side == 'b') ? BLACK : WHITE;
+    p.expected.assign(TEST_POSITIONS[i].counts, TEST_POSITIONS[i].counts + 6);
+    positions.push_back(p);
+  }
+  return positions;
+}
+
+// a kernel's timings, in ns per call, and its results for comparing
+// kernels: every position's legal moves for the side whose turn it is
+// taken to be, and both sides' mobility
+struct KernelResult {
+  double movesNs;
+  double mobilityNs;
+  vector<uint64_t> moves;
+  vector<int> mobility;
+};
+
+// times legalMoves, and separately mobility, over the positions with the
+// current kernel
+static KernelResult timeKernel(const vector<Board> &boards)
+{
+  KernelResult result;
+  uint64_t sum = 0;
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  for (int round = 0; round < KERNEL_ROUNDS; round++)
+  {
+    for (size_t i = 0; i < boards.size(); i++)
+    {
+      sum += boards[i].legalMoves((Side) (i & 1));
+    }
+  }
+  double seconds = chrono::duration<double>(chrono::steady_clock::now()
+                                            - start).count();
+  result.movesNs = seconds * 1e9 / ((double) KERNEL_ROUNDS * boards.size());
+  start = chrono::steady_clock::now();
+  for (int round = 0; round < KERNEL_ROUNDS; round++)
+  {
+    for (size_t i = 0; i < boards.size(); i++)
+    {
+      sum += boards[i].mobility(BLACK) - boards[i].mobility(WHITE);
+    }
+  }
+  seconds = chrono::duration<double>(chrono::steady_clock::now()
+                                     - start).count();
+  // two mobility calls a position a round
+  result.mobilityNs = seconds * 1e9
+                    / (2.0 * KERNEL_ROUNDS * boards.size());
+  result.moves.resize(boards.size());
+  result.mobility.resize(2 * boards.size());
+  for (size_t i = 0; i < boards.size(); i++)
+  {
+    result.moves[i] = boards[i].legalMoves((Side) (i & 1));
+    result.mobility[2 * i] = boards[i].mobility(BLACK);
+    result.mobility[2 * i + 1] = boards[i].mobility(WHITE);
+  }
+  printf("  %-6s %6.2f ns per legalMoves, %6.2f ns per mobility "
+         "(checksum %016llx)\n", moveKernelName(), result.movesNs,
+         result.mobilityNs, (unsigned long long) sum);
+  return result;
+}
+
+static int compareKernels(int count)
+{
+  // positions from random games, every ply of every game
+  vector<Board> boards;
+  mt19937 generator(1);
+  while ((int) boards.size() < count)
+  {
+    Board board;
+    Side side = BLACK;
+    while (!board.isDone() && (int) boards.size() < count)
+    {
+      boards.push_back(board);
+      uint64_t legal = board.legalMoves(side);
+      if (legal != 0)
+      {
+        for (int k = generator() % __builtin_popcountll(legal); k > 0; k--)
+        {
+          legal &= legal - 1;
+        }
+        board.makeMove(__builtin_ctzll(legal), side);
+      }
+      side = flip(side);
+    }
+  }
+  printf("%d positions, %d rounds\n", count, KERNEL_ROUNDS);
+  setMoveKernel(KERNEL_SCALAR);
+  KernelResult scalar = timeKernel(boards);
+  bool ok = true;
+  if (setMoveKernel(KERNEL_AVX2))
+  {
+    KernelResult avx2 = timeKernel(boards);
+    ok = avx2.moves == scalar.moves && avx2.mobility == scalar.mobility;
+    printf("avx2 is %.2fx the speed of scalar for legalMoves and %.2fx for "
+           "mobility, %s\n", scalar.movesNs / avx2.movesNs,
+           scalar.mobilityNs / avx2.mobilityNs,
+           ok ? "same moves" : "MOVES DIFFER");
+  }
+  else
+  {
+    printf("this CPU has no AVX2\n");
+  }
+  setMoveKernel(KERNEL_AUTO);
+  return ok ? 0 : 1;
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc >= 2 && !strcmp(argv[1], "kernels"))
+  {
+    int count = (argc >= 3) ? atoi(argv[2]) : DEFAULT_KERNEL_POSITIONS;
+    return compareKernels(max(count, 1));
+  }
+  if (argc >= 3 && !strcmp(argv[1], "-kernel"))
+  {
+    MoveKernel kernel = !strcmp(argv[2], "scalar") ? KERNEL_SCALAR
+                      : !strcmp(argv[2], "avx2") ? KERNEL_AVX2 : KERNEL_AUTO;
+    if ((kernel == KERNEL_AUTO && strcmp(argv[2], "auto"))
+     || !setMoveKernel(kernel))
+    {
+      fprintf(stderr, "cannot use the %s kernel\n", argv[2]);
+      return 1;
+    }
+    argc -= 2;
+    argv += 2;
+  }
+  int depth = (argc >= 2) ? atoi(argv[1]) : DEFAULT_PERFT_DEPTH;
+  if (depth < 1 || depth > MAX_PERFT_DEPTH)
+  {
+    fprintf(stderr, "usage: %s [-kernel auto|scalar|avx2] [DEPTH [FILE]], "
+                    "DEPTH from 1 to %d\n"
+                    "       %s kernels [POSITIONS]\n",
+            argv[0], MAX_PERFT_DEPTH, argv[0]);
+    return 1;
+  }
+  printf("%s move generation\n", moveKernelName());
+  vector<PerftPosition> positions;
+  if (argc >= 3)
+  {
+    FILE *file = fopen(argv[2], "r");
+    if (file == nullptr)
+    {
+      fprintf(stderr, "could not read %s\n", argv[2]);
+      return 1;
+    }
+    char line[1024];
+    int lineNumber = 0;
+    while (fgets(line, sizeof(line), file) != nullptr)
+    {
+      lineNumber++;
+      PerftPosition p;
+      if (parsePosition(line, &p))
+      {
+        p.name = string(argv[2]) + ":" + to_string(lineNumber);
+        positions.push_back(p);
+      }
+    }
+    fclose(file);
+  }
+  else
+  {
+    positions = builtinPositions();
+  }
+
+  bool ok = true;
+  for (size_t i = 0; i < positions.size(); i++)
+  {
+    int maxDepth = depth;
+    if (argc < 3)
+    {
+      maxDepth = min(depth, (int) positions[i].expected.size());
+    }
+    ok = run(positions[i], maxDepth) && ok;
+  }
+  printf(ok ? "all counts correct\n" : "SOME COUNTS WRONG\n");
+  return ok ? 0 : 1;
+}
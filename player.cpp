@@ -3,6 +3,11 @@
 
 #include "player.hpp"
 #include "tree.hpp"
+#include "search.hpp"
+#include "smp.hpp"
+#include <algorithm>
+#include <string>
+#include <thread>
 
 using namespace std;
 /*
@@ -15,6 +20,25 @@ using namespace std;
 Player::Player(Side side) {
     // Will be set to true in test_minimax.cpp.
     testingMinimax = false;
+    useTree = false;
+    untimedDepth = 8;
+    endgameEmpties = 20;
+    exactEmpties = 16;
+    threads = 1;
+    verbose = false;
+    ponder = false;
+    pondering = false;
+    ponderStop = false;
+    ponderDepth = 0;
+    ponderScore = 0;
+    reuseSearch = true;
+    stopSearch = false;
+    lastLineLength = 0;
+    lastDepth = 0;
+    lastScore = 0;
+    lastMsLeft = -1;
+    lastMoveMs = 0;
+    overheadMs = -1;
 
     /*
      * Do any initialization you need to do here (setting up the board,
@@ -22,10 +46,16 @@ Player::Player(Side side) {
      * 30 seconds.
      */
   //cerr << "creating Player" << endl;
-  board = new Board();
   mySide = side;
   oppSide = flip(side);
   moveNumber = 0;
+  // without a weights file the evaluator keeps its built-in weights, and
+  // the same goes for the ProbCut parameters
+  evaluator.load(DEFAULT_WEIGHTS_FILE);
+  probcut.load(DEFAULT_PROBCUT_FILE);
+  // mapping the book is cheap whatever its size; pages are read in as
+  // positions are looked up
+  book.open(DEFAULT_BOOK_FILE);
   //cerr << "finished creating player" << endl;
 }
 
@@ -34,7 +64,7 @@ Player::Player(Side side) {
  */
 Player::~Player() {
   //cerr << "beginning to delete player" << endl;
-  delete board;
+  stopPondering(nullptr);
   //cerr << "finished deleting player" << endl;
 }
 
@@ -57,7 +87,20 @@ Move *Player::doMove(Move *opponentsMove, int msLeft) {
      * process the opponent's opponents move before calculating your own move
      */
   moveNumber += 1;
-  if (opponentsMove == nullptr || board->isDone()) 
+  moveStart = chrono::steady_clock::now();
+  if (msLeft >= 0 && lastMsLeft >= 0)
+  {
+    overheadMs = max(overheadMs, lastMsLeft - lastMoveMs - msLeft);
+  }
+  lastMsLeft = msLeft;
+  // the ponder search reads the board and the table, so it has to finish
+  // before either changes
+  bool ponderHit = stopPondering(opponentsMove);
+  // did the opponent play the reply our last search expected?
+  int played = (opponentsMove == nullptr) ? NO_MOVE : opponentsMove->square;
+  bool predicted = reuseSearch && lastLineLength >= 3
+                && lastLine[1] == played && lastLine[2] != NO_MOVE;
+  if (opponentsMove == nullptr || board.isDone()) 
   {
     // then the board does not need to be updated. the opponent did not make a
     // move
@@ -65,52 +108,321 @@ Move *Player::doMove(Move *opponentsMove, int msLeft) {
   }
   else 
   {
-   //  cerr << "Received opp move " << opponentsMove->x << " "
-     //  << opponentsMove->y << endl;
-    board->doMove(opponentsMove, oppSide); 
+   //  cerr << "Received opp move " << opponentsMove->getX() << " "
+     //  << opponentsMove->getY() << endl;
+    board.doMove(opponentsMove, oppSide); 
+  }
+  if (reuseSearch)
+  {
+    tt.newSearch();
+  }
+  Move hint;
+  int startDepth = 1;
+  int expectedScore = 0;
+  if (predicted)
+  {
+    // the table still holds our last search's subtree for this position,
+    // two plies shallower
+    hint.square = lastLine[2];
+    startDepth = lastDepth - 2;
+    expectedScore = lastScore;
   }
+  if (ponderHit)
+  {
+    // after a ponder hit the table already holds a deep search of this
+    // position, so the iterations up to that depth go quickly
+    hint = ponderBest;
+    if (reuseSearch && ponderDepth >= startDepth)
+    {
+      startDepth = ponderDepth;
+      expectedScore = ponderScore;
+    }
+  }
+  lastLineLength = 0;
   // check if there are any legal moves
-  if (!board->hasMoves(mySide)) 
+  if (!board.hasMoves(mySide)) 
   {
   //  cerr << "no moves on my side. sending nullptr." << endl;
+    finishMove();
     return nullptr;
   }
-  // otherwise, we will proceed to construct the decision tree
+  Move * lastMoveSent = new Move();
+  if (!testingMinimax && book.probe(board, mySide, lastMoveSent, nullptr))
+  {
+    // a book move needs no search
+  }
+  else if (useTree)
+  {
+    *lastMoveSent = treeMove(treeDepth(msLeft));
+  }
+  else
+  {
+    TimeManager timer;
+    timer.start(msLeft, board.countEmpty(),
+                (overheadMs < 0) ? MOVE_OVERHEAD_MS
+                                 : overheadMs + MOVE_OVERHEAD_MARGIN_MS);
+    *lastMoveSent = searchMove(timer, hint, startDepth, expectedScore);
+  }
+  // do the move on the internal board. it came out of our own search so it is
+  // known to be legal and can skip the validating doMove
+  // cerr << "sending move " << lastMoveSent->getX() << " "
+  //      << lastMoveSent->getY() << endl;
+  board.makeMove(lastMoveSent->square, mySide);
+  finishMove();
+  return lastMoveSent;
+}
+
+// this function is called as doMove returns its move
+void Player::finishMove()
+{
+  lastMoveMs = chrono::duration_cast<chrono::milliseconds>(
+    chrono::steady_clock::now() - moveStart).count();
+  startPondering();
+}
+
+// this function starts a new game as side, stopping any ponder search
+void Player::newGame(Side side)
+{
+  stopPondering(nullptr);
+  board = Board();
+  mySide = side;
+  oppSide = flip(side);
+  moveNumber = 0;
+  lastLineLength = 0;
+  lastDepth = 0;
+  lastScore = 0;
+  lastMsLeft = -1;
+  lastMoveMs = 0;
+  overheadMs = -1;
+}
+
+int Player::ponderMove() const
+{
+  return pondering ? ponderReply : -1;
+}
+
+// this function names a square the usual way, "a1" to "h8" with x as the
+// column letter and y + 1 as the row number. NO_MOVE is a pass
+static string squareName(int square)
+{
+  if (square == NO_MOVE)
+  {
+    return "pass";
+  }
+  string name;
+  name += (char) ('a' + (square & 7));
+  name += (char) ('1' + (square >> 3));
+  return name;
+}
+
+// this function runs the search for our move on the current board
+Move Player::searchMove(TimeManager &timer, Move hint, int startDepth,
+                        int expectedScore)
+{
+  Move best = hint;
+  Search search(&tt, &evaluator);
+  if (testingMinimax)
+  {
+    // test_minimax wants a plain 2-ply search
+    search.iterativeDeepening(board, mySide, 2, nullptr, &best);
+    return best;
+  }
+  int empties = board.countEmpty();
+  if (empties <= endgameEmpties)
+  {
+    // a quick shallow search first, so that there is still a sensible move
+    // if the solver runs out of time or finds that every move loses
+    search.iterativeDeepening(board, mySide, ENDGAME_FALLBACK_DEPTH, nullptr,
+                              &best);
+    EndgameMode mode = (empties <= exactEmpties) ? SOLVE_EXACT : SOLVE_WLD;
+    EndgameSolver solver(&tt);
+    solver.stop = &stopSearch;
+    Move solved;
+    int score = solver.solve(board, mySide, mode, &timer, &solved);
+    if (!solver.aborted && (mode == SOLVE_EXACT || score >= 0))
+    {
+      best = solved;
+      uint8_t line = best.square;
+      report(empties, score * DISC_WIN_SCALE, search.nodes + solver.nodes,
+             timer.elapsedMs(), &line, 1);
+    }
+    return best;
+  }
+  // deepen until the time manager's share of the clock for this move is
+  // used up
+  int maxDepth = timer.unlimited() ? untimedDepth : MAX_DEPTH;
+  ParallelSearch parallel(&tt, &evaluator, threads, &probcut);
+  if (reuseSearch)
+  {
+    parallel.startDepth = startDepth;
+    parallel.expectedScore = expectedScore;
+  }
+  parallel.stop = &stopSearch;
+  if (onInfo)
+  {
+    parallel.onIteration = [&](const Search &s, int iterationScore) {
+      report(s.completedDepth, iterationScore, s.nodes, timer.elapsedMs(),
+             s.bestLine, s.bestLineLength);
+    };
+  }
+  int score = parallel.iterativeDeepening(board, mySide, maxDepth, &timer,
+                                         &best);
+  if (!((board.legalMoves(mySide) >> best.square) & 1))
+  {
+    // stopped before even the first iteration was done. a 1-ply search
+    // takes no time
+    search.iterativeDeepening(board, mySide, 1, nullptr, &best);
+  }
+  report(parallel.completedDepth, score, parallel.nodes, timer.elapsedMs(),
+         parallel.bestLine, parallel.bestLineLength);
+  lastLineLength = parallel.bestLineLength;
+  copy(parallel.bestLine, parallel.bestLine + lastLineLength, lastLine);
+  lastDepth = parallel.completedDepth;
+  lastScore = score;
+  if (verbose)
+  {
+    cerr << "depth " << parallel.completedDepth << " score " << score
+         << " nodes " << parallel.nodes << " time " << timer.elapsedMs()
+         << " first-move cutoffs " << parallel.firstMoveCutoffRate() << "%"
+         << " pv";
+    for (int i = 0; i < parallel.bestLineLength; i++)
+    {
+      cerr << " " << squareName(parallel.bestLine[i]);
+    }
+    cerr << endl;
+  }
+  return best;
+}
+
+// this function passes the search's progress on to onInfo, if it is set
+void Player::report(int depth, int score, long long nodes, int ms,
+                    const uint8_t *line, int lineLength)
+{
+  if (!onInfo)
+  {
+    return;
+  }
+  SearchInfo info;
+  info.depth = depth;
+  info.score = score;
+  info.nodes = nodes;
+  info.ms = ms;
+  info.lineLength = lineLength;
+  copy(line, line + lineLength, info.line);
+  onInfo(info);
+}
+
+// this function resizes the transposition table. the table is also cleared
+void Player::setHashSize(int sizeMB)
+{
+  stopPondering(nullptr);
+  tt.resize(sizeMB);
+}
+
+// this function starts searching the position after the opponent's expected
+// reply in the background. the board must not change until stopPondering
+void Player::startPondering()
+{
+  if (!ponder || testingMinimax || useTree || board.isDone())
+  {
+    return;
+  }
+  uint64_t replies = board.legalMoves(oppSide);
+  ponderReply = (lastLineLength >= 2) ? lastLine[1] : -1;
+  if (replies == 0)
+  {
+    ponderReply = NO_MOVE;
+  }
+  else if (ponderReply < 0 || ponderReply == NO_MOVE
+        || !((replies >> ponderReply) & 1))
+  {
+    // no usable guess from the search (after a book move, say); the table
+    // may still have one
+    TTEntry entry;
+    bool known = tt.probe(board.getKey(oppSide), &entry)
+              && ((replies >> entry.move) & 1);
+    ponderReply = known ? entry.move : -1;
+  }
+  ponderBoard = board;
+  ponderSide = mySide;
+  if (ponderReply >= 0 && ponderReply != NO_MOVE)
+  {
+    ponderBoard.makeMove(ponderReply, oppSide);
+  }
+  else if (ponderReply < 0)
+  {
+    // without a guess, search the opponent's position. that fills the
+    // table for all of the replies
+    ponderSide = oppSide;
+  }
+  if (!ponderBoard.hasMoves(ponderSide))
+  {
+    return;
+  }
+  ponderBest = Move();
+  ponderDepth = 0;
+  ponderStop = false;
+  pondering = true;
+  ponderThread = thread([this]() {
+    ParallelSearch search(&tt, &evaluator, threads, &probcut);
+    search.stop = &ponderStop;
+    Move best;
+    int score = search.iterativeDeepening(ponderBoard, ponderSide, MAX_DEPTH,
+                                          nullptr, &best);
+    ponderBest = best;
+    ponderDepth = search.completedDepth;
+    ponderScore = score;
+  });
+}
+
+// this function stops the ponder search, if there is one, and returns
+// whether it searched the position that the opponent's move led to.
+// opponentsMove is nullptr for a pass
+bool Player::stopPondering(Move *opponentsMove)
+{
+  if (!pondering)
+  {
+    return false;
+  }
+  ponderStop = true;
+  ponderThread.join();
+  pondering = false;
+  int actual = (opponentsMove == nullptr) ? NO_MOVE : opponentsMove->square;
+  bool hit = ponderReply >= 0 && actual == ponderReply && ponderDepth > 0;
+  if (verbose)
+  {
+    cerr << (hit ? "ponder hit" : "ponder miss") << " depth " << ponderDepth
+         << endl;
+  }
+  return hit;
+}
+
+// this function picks how many plies the tree search grows for this move
+int Player::treeDepth(int msLeft)
+{
+  if (msLeft < 30000)
+  {
+    return 4; // speed is of the essence for the last 30 seconds!
+  }
+  if (moveNumber < 50) {return 6;}
+  return 8;
+}
+
+// this function finds a move by growing the full decision tree. this is the
+// original search, kept so it can be compared against Search
+Move Player::treeMove(int depth)
+{
   Tree tree = Tree();
   Node * root = new Node();
-  root->board = board->copy();
-  root->lastMove = nullptr;
+  root->board = board;
   root->depth = 0;
   root->nextToPlay = mySide;
   tree.root = root;
   tree.currentDepth = 0;
   //cerr << "decision tree constructed" << endl;
   // now proceed to grow the tree to n generations
-  //if (testingMinimax)
-  //{
-  //  tree.growTree(2);
-  //}
-  //else
-  //{
-  if (msLeft < 30000)
-  {
-    tree.growTree(4); // speed is of the essence for the last 30 seconds!
-  }
-  else
-  {
-    if (moveNumber < 50) {tree.growTree(6);}
-    else {tree.growTree(8);}
-    //cerr << "decision tree grown" << endl;
-  }
-  //}
+  tree.growTree(depth);
+  //cerr << "decision tree grown" << endl;
   // get the best move from the grown tree
-  Move * lastMoveSent = new Move(-1, -1);
-  Move * bestMove = tree.getBestMove(mySide);
-  lastMoveSent->x = bestMove->x;
-  lastMoveSent->y = bestMove->y;
-  // do the move on the internal board
-  // cerr << "sending move " << lastMoveSent->x << " " << lastMoveSent->y << endl;
-  board->doMove(lastMoveSent, mySide);
-  return lastMoveSent;
+  return *tree.getBestMove(mySide);
 }
-
@@ -2,14 +2,35 @@
 #define __PLAYER_H__
 
 #include <iostream>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
 #include "common.hpp"
 #include "board.hpp"
+#include "tt.hpp"
+#include "endgame.hpp"
+#include "timemanager.hpp"
+#include "eval.hpp"
+#include "probcut.hpp"
+#include "book.hpp"
+#include "ordering.hpp"
 using namespace std;
 
+// Progress of the search for a move, as passed to Player::onInfo.
+struct SearchInfo {
+  int depth; // last completed depth, or the number of empties if solved
+  int score; // in Search's units, for the player
+  long long nodes;
+  int ms; // since the search started
+  uint8_t line[MAX_PLY]; // expected line of play; NO_MOVE is a pass
+  int lineLength;
+};
+
 class Player {
 
 public:
-  Board * board;
+  Board board;
   Side mySide;
   Side oppSide;
   Player(Side side);
@@ -20,6 +41,117 @@ public:
 
     // Flag to tell if the player is running within the test_minimax context
     bool testingMinimax;
+
+    // Use the old materialized Tree search instead of the negamax Search.
+    // Only kept around for comparison, with the player's -tree option.
+    bool useTree;
+
+    // Deepest iteration to search when the game is untimed (msLeft < 0).
+    int untimedDepth;
+
+    // Once this many squares or fewer are empty, the endgame solver looks
+    // for a won (or drawn) line; at exactEmpties or fewer it maximizes the
+    // final disc difference instead. Set to -1 to disable.
+    int endgameEmpties;
+    int exactEmpties;
+
+    // Number of search threads. Defaults to one: the opponent usually
+    // shares the machine, and how the search scales with more has not been
+    // measured on a machine with more than one core.
+    int threads;
+
+    // Print search statistics for every move to stderr.
+    bool verbose;
+
+    // Keep searching in the background while the opponent thinks: after
+    // each move, the position after the opponent's expected reply is
+    // searched until the opponent's move arrives. If the guess was right,
+    // the search for our move starts from a warm table and the ponder
+    // search's best move; if not, the ponder search is abandoned. Off by
+    // default; the ponder search uses as many threads as the search.
+    bool ponder;
+
+    // Pattern evaluator, loaded from DEFAULT_WEIGHTS_FILE if there is one.
+    Evaluator evaluator;
+
+    // Multi-ProbCut parameters, loaded from DEFAULT_PROBCUT_FILE if there
+    // is one. Set probcut.enabled to false for a full-width search.
+    ProbCut probcut;
+
+    // Opening book, mapped from DEFAULT_BOOK_FILE if there is one. Book
+    // moves are played without searching.
+    OpeningBook book;
+
+    // Positions searched so far, shared between moves and threads.
+    TranspositionTable tt;
+    void setHashSize(int sizeMB);
+
+    // Carry search state over from one move to the next: table entries
+    // from earlier moves make way for new ones as they age, and when the
+    // opponent plays the reply our last search expected, iterative
+    // deepening resumes two plies short of that search's depth, from the
+    // next move of its line, instead of starting again from depth 1.
+    bool reuseSearch;
+
+    // Set from another thread to make doMove stop searching and play the
+    // best move found so far. doMove never clears it.
+    atomic<bool> stopSearch;
+
+    // If set, doMove calls this with the search's progress after every
+    // completed iteration, counting the nodes of the main search thread,
+    // and once more with the totals of all threads when it is done. Book
+    // moves are not reported.
+    function<void(const SearchInfo &)> onInfo;
+
+    // Starts a new game as side from the initial position. The table and
+    // the options are kept.
+    void newGame(Side side);
+
+    // The opponent's reply that the ponder search assumes, NO_MOVE for a
+    // pass, or -1 if there is no ponder search or it does not assume one.
+    int ponderMove() const;
+
+    // Stops the ponder search, if there is one. Returns true if it was
+    // pondering on opponentsMove (nullptr for a pass) and got somewhere,
+    // in which case doMove can build on it. Not to be called while doMove
+    // runs.
+    bool stopPondering(Move *opponentsMove);
+
+private:
+    thread ponderThread;
+    atomic<bool> ponderStop;
+    bool pondering;
+    Board ponderBoard; // position being pondered
+    Side ponderSide; // side to move in it
+    int ponderReply; // expected reply, NO_MOVE for a pass, or -1 if the
+                     // reply could not be guessed and the position before
+                     // it is pondered instead
+    Move ponderBest; // best move found by the ponder search so far
+    int ponderDepth; // depth the ponder search completed
+    int ponderScore; // and its score
+    // expected line of play from our last search, its depth and its score.
+    // the line is empty if the last move did not come from a search
+    uint8_t lastLine[MAX_PLY];
+    int lastLineLength;
+    int lastDepth;
+    int lastScore;
+    // the clock when our last move was asked for and how long we took over
+    // it, -1 if it was untimed, and the most the clock has lost between
+    // moves besides our own time, -1 until it has been seen. the reserve
+    // for the driver's overhead comes down to what it really costs
+    int lastMsLeft;
+    int lastMoveMs;
+    int overheadMs;
+    chrono::steady_clock::time_point moveStart;
+
+    void finishMove();
+    Move searchMove(TimeManager &timer, Move hint, int startDepth,
+                    int expectedScore);
+    void report(int depth, int score, long long nodes, int ms,
+                const uint8_t *line, int lineLength);
+    void startPondering();
+    int treeDepth(int msLeft);
+    Move treeMove(int depth);
 };
 
 #endif
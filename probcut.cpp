@@ -0,0 +1,153 @@
+// Multi-ProbCut parameters for the Othello AI
+
+#include "probcut.hpp"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+using namespace std;
+
+const int MPC_FITTED_DEPTH = 10; // deepest depth with built-in parameters.
+                                 // deeper ones reuse the deepest regression
+                                 // of the same parity
+
+// a, b and sigma for depths MPC_MIN_DEPTH to MPC_FITTED_DEPTH, by phase, as
+// printed by "mpctool fit 1200 10"
+static const float DEFAULT_FIT[MPC_PHASES][MPC_FITTED_DEPTH - MPC_MIN_DEPTH
+                                           + 1][3] = {
+  {
+    {0.828f, 329.7f, 926.3f},
+    {0.811f, -126.8f, 889.1f},
+    {0.732f, 479.1f, 1069.7f},
+    {0.735f, -167.0f, 964.5f},
+    {0.803f, 280.6f, 1034.2f},
+    {0.845f, -82.0f, 954.2f},
+    {0.751f, 363.2f, 1122.4f},
+    {0.817f, -202.5f, 1092.5f},
+  },
+  {
+    {1.019f, 226.0f, 1690.4f},
+    {1.067f, 8.0f, 1574.4f},
+    {1.080f, 362.3f, 2744.7f},
+    {1.123f, 48.4f, 2503.2f},
+    {1.156f, 195.2f, 2149.8f},
+    {1.143f, -3.5f, 1932.6f},
+    {1.223f, 238.5f, 2741.5f},
+    {1.233f, -57.8f, 2571.2f},
+  },
+  {
+    {1.079f, -6.9f, 2675.1f},
+    {1.110f, -91.0f, 2234.8f},
+    {1.178f, -50.3f, 4188.3f},
+    {1.212f, -35.9f, 3472.6f},
+    {1.210f, 18.4f, 3167.0f},
+    {1.206f, 18.9f, 2720.2f},
+    {1.309f, -30.9f, 4106.7f},
+    {1.316f, 50.0f, 3688.1f},
+  },
+  {
+    {1.102f, 283.3f, 3219.7f},
+    {1.102f, 173.7f, 3016.3f},
+    {1.211f, 304.8f, 5241.0f},
+    {1.217f, 496.4f, 4662.9f},
+    {1.227f, 58.6f, 4316.3f},
+    {1.216f, 526.3f, 3874.4f},
+    {1.329f, 325.8f, 5761.3f},
+    {1.324f, 902.4f, 5513.2f},
+  },
+};
+
+ProbCut::ProbCut()
+{
+  enabled = true;
+  threshold = MPC_DEFAULT_THRESHOLD;
+  memset(table, 0, sizeof(table));
+  for (int phase = 0; phase < MPC_PHASES; phase++)
+  {
+    for (int depth = MPC_MIN_DEPTH; depth <= MPC_MAX_DEPTH; depth++)
+    {
+      int fitted = (depth <= MPC_FITTED_DEPTH) ? depth
+                 : MPC_FITTED_DEPTH - ((depth - MPC_FITTED_DEPTH) & 1);
+      const float *fit = DEFAULT_FIT[phase][fitted - MPC_MIN_DEPTH];
+      ProbCutRegression &r = table[phase][depth];
+      r.shallow = shallowDepth(depth);
+      r.a = fit[0];
+      r.b = fit[1];
+      r.sigma = fit[2];
+    }
+  }
+}
+
+int ProbCut::phaseOf(const Board &board)
+{
+  int phase = (60 - board.countEmpty()) / 10;
+  return (phase >= MPC_PHASES) ? MPC_PHASES - 1 : phase;
+}
+
+int ProbCut::shallowDepth(int depth)
+{
+  // about half the depth, rounded down to the same parity
+  int shallow = depth / 2;
+  return shallow - ((depth - shallow) & 1);
+}
+
+const ProbCutRegression *ProbCut::regression(int phase, int depth) const
+{
+  if (depth < MPC_MIN_DEPTH || depth > MPC_MAX_DEPTH)
+  {
+    return nullptr;
+  }
+  const ProbCutRegression *r = &table[phase][depth];
+  return (r->shallow > 0 && r->a > 0 && r->sigma > 0) ? r : nullptr;
+}
+
+bool ProbCut::load(const char *path)
+{
+  FILE *file = fopen(path, "rb");
+  if (file == nullptr)
+  {
+    return false;
+  }
+  char magic[4];
+  uint32_t header[3];
+  bool ok = fread(magic, 1, 4, file) == 4 && memcmp(magic, "OTHP", 4) == 0
+         && fread(header, 4, 3, file) == 3
+         && header[0] == PROBCUT_FILE_VERSION && header[1] == MPC_PHASES
+         && header[2] == MPC_MAX_DEPTH;
+  if (ok)
+  {
+    ProbCutRegression loaded[MPC_PHASES][MPC_MAX_DEPTH + 1];
+    static_assert(sizeof(ProbCutRegression) == 16, "file layout");
+    size_t count = MPC_PHASES * (MPC_MAX_DEPTH + 1);
+    ok = fread(loaded, sizeof(ProbCutRegression), count, file) == count;
+    // a regression whose shallow search is not shallower than its deep one
+    // would have the search recurse without end
+    for (int phase = 0; ok && phase < MPC_PHASES; phase++)
+    {
+      for (int depth = 0; ok && depth <= MPC_MAX_DEPTH; depth++)
+      {
+        const ProbCutRegression &r = loaded[phase][depth];
+        ok = !(r.a > 0) || (r.shallow >= 1 && r.shallow <= depth - 1
+                            && r.sigma > 0 && isfinite(r.a)
+                            && isfinite(r.b) && isfinite(r.sigma));
+      }
+    }
+    if (ok) {memcpy(table, loaded, sizeof(table));}
+  }
+  fclose(file);
+  return ok;
+}
+
+bool ProbCut::save(const char *path) const
+{
+  FILE *file = fopen(path, "wb");
+  if (file == nullptr)
+  {
+    return false;
+  }
+  uint32_t header[3] = {PROBCUT_FILE_VERSION, MPC_PHASES, MPC_MAX_DEPTH};
+  size_t count = MPC_PHASES * (MPC_MAX_DEPTH + 1);
+  bool ok = fwrite("OTHP", 1, 4, file) == 4
+         && fwrite(header, 4, 3, file) == 3
+         && fwrite(table, sizeof(ProbCutRegression), count, file) == count;
+  return fclose(file) == 0 && ok;
+}
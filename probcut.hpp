@@ -0,0 +1,70 @@
+#ifndef __PROBCUT_H__
+#define __PROBCUT_H__
+
+#include <cstdint>
+#include "common.hpp"
+#include "board.hpp"
+
+// Multi-ProbCut (Buro) forward pruning. The result of a deep search is
+// predicted from a shallow search of the same position by linear
+// regression, deep = a * shallow + b, with the prediction's error having
+// standard deviation sigma. When the shallow search says that the deep one
+// lies outside the window with high confidence, the node is cut without the
+// deep search. There is one regression per search depth and game phase, and
+// the shallow depth for each has the same parity as the deep one, since
+// searches ending on either side's move are biased in opposite directions.
+//
+// The parameters are fitted offline by mpctool from full-width searches and
+// can be loaded from a binary file:
+//   char[4]  "OTHP"
+//   uint32   version (PROBCUT_FILE_VERSION)
+//   uint32   number of phases (MPC_PHASES)
+//   uint32   deepest depth (MPC_MAX_DEPTH)
+//   then for each phase, for each depth from 0 to MPC_MAX_DEPTH:
+//   int32    shallow depth (0 if there is no regression for this depth)
+//   float    a, b, sigma
+// all little-endian, scores in Search's units. A file is rejected if any
+// regression with a > 0 has a shallow depth outside 1 to depth - 1 or a
+// sigma that is not positive.
+
+using namespace std;
+
+const int MPC_PHASES = 4;
+const int MPC_MIN_DEPTH = 3; // shallower nodes are cheaper to search fully
+const int MPC_MAX_DEPTH = 24;
+const double MPC_DEFAULT_THRESHOLD = 1.5; // in standard deviations
+const uint32_t PROBCUT_FILE_VERSION = 1;
+const char DEFAULT_PROBCUT_FILE[] = "othello.probcut";
+
+struct ProbCutRegression {
+  int32_t shallow;
+  float a;
+  float b;
+  float sigma;
+};
+
+class ProbCut {
+public:
+  // starts out with the built-in parameters, fitted by mpctool
+  ProbCut();
+  bool load(const char *path); // returns false and keeps the current
+                               // parameters if the file is missing or
+                               // invalid
+  bool save(const char *path) const;
+
+  // cuts are only tried while this is set
+  bool enabled;
+  // how many standard deviations outside the window the prediction has to
+  // be. higher is safer and prunes less
+  double threshold;
+
+  static int phaseOf(const Board &board);
+  // shallow depth paired with the given deep one
+  static int shallowDepth(int depth);
+  // the regression for a depth, or nullptr where there is none
+  const ProbCutRegression *regression(int phase, int depth) const;
+
+  ProbCutRegression table[MPC_PHASES][MPC_MAX_DEPTH + 1];
+};
+
+#endif
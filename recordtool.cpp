@@ -0,0 +1,206 @@
+// Converts and checks game record files for the Othello AI.
+//
+//   recordtool convert TEXT FILE
+//     writes the games in the text file TEXT, one game per line written as
+//     its moves, e.g. "f5d6c3d3c4" (as for booktool games), to the record
+//     file FILE. passes are filled in where a side has no move, and the
+//     margin is taken from the last position
+//   recordtool dump FILE
+//     prints every game of FILE in the same text form, followed by black's
+//     margin and, for a forfeited game, "forfeit"
+//   recordtool replay FILE
+//     plays through every game of FILE from the memory map, checking every
+//     move, and prints how many games and positions there were and how fast
+//     they were replayed
+//
+// The file format is described in gamerecord.hpp.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <chrono>
+#include "board.hpp"
+#include "ordering.hpp"
+#include "gamerecord.hpp"
+using namespace std;
+
+static int convert(const char *text, const char *path)
+{
+  FILE *file = fopen(text, "r");
+  if (file == nullptr)
+  {
+    fprintf(stderr, "could not read %s\n", text);
+    return 1;
+  }
+  RecordWriter writer;
+  if (!writer.open(path))
+  {
+    fclose(file);
+    fprintf(stderr, "could not write %s\n", path);
+    return 1;
+  }
+  GameRecord game;
+  char line[1024];
+  int lineNumber = 0;
+  int games = 0;
+  while (fgets(line, sizeof(line), file) != nullptr)
+  {
+    lineNumber++;
+    memset(&game.header, 0, sizeof(RecordHeader));
+    Board board;
+    Side side = BLACK;
+    bool ok = true;
+    for (char *c = line; ok && c[0] != 0 && c[1] != 0; c += 2)
+    {
+      int x = tolower(c[0]) - 'a';
+      int y = c[1] - '1';
+      if (x < 0 || x > 7 || y < 0 || y > 7)
+      {
+        break; // end of the moves
+      }
+      if (board.legalMoves(side) == 0 && board.hasMoves(flip(side)))
+      {
+        game.moves[game.header.plies++] = NO_MOVE;
+        side = flip(side);
+      }
+      Move m(x, y);
+      ok = board.checkMove(&m, side);
+      if (!ok)
+      {
+        fprintf(stderr, "line %d: illegal move %c%c\n", lineNumber, c[0],
+                c[1]);
+        break;
+      }
+      board.doMove(&m, side);
+      game.moves[game.header.plies++] = m.square;
+      side = flip(side);
+    }
+    if (!ok || game.header.plies == 0)
+    {
+      continue;
+    }
+    game.header.margin = board.countBlack() - board.countWhite();
+    writer.write(game);
+    games++;
+  }
+  fclose(file);
+  if (!writer.close())
+  {
+    fprintf(stderr, "could not write %s\n", path);
+    return 1;
+  }
+  fprintf(stderr, "%d games\n", games);
+  return 0;
+}
+
+static int dump(const char *path)
+{
+  RecordReader reader;
+  if (!reader.open(path))
+  {
+    fprintf(stderr, "could not read %s\n", path);
+    return 1;
+  }
+  GameView game;
+  while (reader.next(&game))
+  {
+    for (int i = 0; i < game.header.plies; i++)
+    {
+      int square = game.moves[i];
+      if (square != NO_MOVE)
+      {
+        printf("%c%c", 'a' + (square & 7), '1' + (square >> 3));
+      }
+    }
+    printf(" %+d%s\n", game.header.margin,
+           (game.header.flags & RECORD_FORFEIT) ? " forfeit" : "");
+  }
+  if (reader.damaged)
+  {
+    fprintf(stderr, "%s is damaged after the games above\n", path);
+    return 1;
+  }
+  return 0;
+}
+
+static int replay(const char *path)
+{
+  RecordReader reader;
+  if (!reader.open(path))
+  {
+    fprintf(stderr, "could not read %s\n", path);
+    return 1;
+  }
+  // reading alone first, to tell the cost of the format from the cost of
+  // playing the moves
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  long long plies = 0;
+  GameView game;
+  while (reader.next(&game))
+  {
+    plies += game.header.plies;
+  }
+  double readSeconds = chrono::duration<double>(chrono::steady_clock::now()
+                                                - start).count();
+  reader.rewind();
+
+  start = chrono::steady_clock::now();
+  long long games = 0;
+  long long positions = 0;
+  int illegal = 0;
+  uint64_t checksum = 0; // so that the replay cannot be optimized away
+  while (reader.next(&game))
+  {
+    Board board;
+    Side side;
+    if (!RecordReader::replay(game, game.header.plies, &board, &side))
+    {
+      illegal++;
+    }
+    checksum ^= board.getKey(side);
+    games++;
+    positions += game.header.plies + 1;
+  }
+  double seconds = chrono::duration<double>(chrono::steady_clock::now()
+                                            - start).count();
+  printf("%lld games, %lld positions, %zu bytes (%.1f bytes per game)\n",
+         games, positions, reader.size(),
+         (games > 0) ? (double) reader.size() / games : 0.0);
+  printf("read in %.3f s: %.1f MB/s, %lld plies\n", readSeconds,
+         (readSeconds > 0) ? reader.size() / readSeconds / 1e6 : 0.0, plies);
+  printf("replayed in %.3f s: %.1f MB/s, %.1f M positions/s, "
+         "checksum %016llx\n", seconds,
+         (seconds > 0) ? reader.size() / seconds / 1e6 : 0.0,
+         (seconds > 0) ? positions / seconds / 1e6 : 0.0,
+         (unsigned long long) checksum);
+  if (illegal > 0)
+  {
+    printf("%d games have illegal moves\n", illegal);
+  }
+  if (reader.damaged)
+  {
+    fprintf(stderr, "%s is damaged after the games above\n", path);
+  }
+  return (illegal > 0 || reader.damaged) ? 1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc == 4 && !strcmp(argv[1], "convert"))
+  {
+    return convert(argv[2], argv[3]);
+  }
+  if (argc == 3 && !strcmp(argv[1], "dump"))
+  {
+    return dump(argv[2]);
+  }
+  if (argc == 3 && !strcmp(argv[1], "replay"))
+  {
+    return replay(argv[2]);
+  }
+  fprintf(stderr, "usage: %s convert TEXT FILE\n"
+                  "       %s dump FILE\n"
+                  "       %s replay FILE\n", argv[0], argv[0], argv[0]);
+  return 1;
+}
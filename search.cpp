@@ -0,0 +1,483 @@
+// Depth-first negamax search for the Othello AI
+
+#include "search.hpp"
+#include "eval.hpp"
+#include "probcut.hpp"
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+using namespace std;
+
+// this function returns the heuristic value of the board for the given side
+int evaluate(const Board &board, Side side)
+{
+  int value = board.getWhiteValue();
+  return (side == WHITE) ? value : -value;
+}
+
+// score of a finished game from the point of view of side
+static int finalScore(const Board &board, Side side)
+{
+  return (board.count(side) - board.count(flip(side))) * DISC_WIN_SCALE;
+}
+
+const int ASPIRATION_MIN_DEPTH = 4; // shallower iterations are too quick
+                                    // for a narrow window to matter
+const int ASPIRATION_WINDOW = DISC_WIN_SCALE / 2; // half width, doubled
+                                                  // after every fail low
+                                                  // or fail high
+const int TT_MOVE_KEY = 1 << 30; // above any killer or history key
+const int ORDER_MOBILITY_DEPTH = 3; // from here on, moves that leave the
+                                    // opponent few replies go first
+const int MOBILITY_WEIGHT = 1 << 14;
+const int ORDER_SHALLOW_DEPTH = 10; // from here on, a shallow search of
+                                    // each move refines the ordering. with
+                                    // the built-in weights the evaluation is
+                                    // a poorer guide than mobility, so this
+                                    // only pays off near the root
+const int SHALLOW_WEIGHT = 16;
+const double ITERATION_GROWTH = 3; // an iteration costs about this many
+                                   // times the one before, until two
+                                   // iterations have been timed
+const double MIN_ITERATION_GROWTH = 1.5;
+const double MAX_ITERATION_GROWTH = 8;
+
+// how long the next iteration is expected to take, from how long the last
+// two took
+static int nextIterationMs(int lastMs, int previousMs)
+{
+  double growth = (previousMs > 0) ? (double) lastMs / previousMs
+                                   : ITERATION_GROWTH;
+  growth = max(MIN_ITERATION_GROWTH, min(MAX_ITERATION_GROWTH, growth));
+  return (int) (lastMs * growth);
+}
+
+Search::Search(TranspositionTable *tt, const Evaluator *eval,
+               const ProbCut *probcut)
+{
+  this->tt = tt;
+  this->eval = eval;
+  this->probcut = probcut;
+  nodes = 0;
+  probCuts = 0;
+  aborted = false;
+  completedDepth = 0;
+  cutoffs = 0;
+  firstMoveCutoffs = 0;
+  timer = nullptr;
+  stop = nullptr;
+  threadId = 0;
+  startDepth = 1;
+  expectedScore = 0;
+}
+
+int Search::iterativeDeepening(const Board &board, Side side, int maxDepth,
+                               const TimeManager *timer, Move *best)
+{
+  this->timer = timer;
+  aborted = false;
+  completedDepth = 0;
+  bestLineLength = 0;
+  int empties = board.countEmpty();
+  int score = 0;
+  int previousScore = 0; // score of the iteration before the last one
+  // there is no point searching deeper than the end of the game
+  maxDepth = min(maxDepth, empties);
+  int firstDepth = 1;
+  if (startDepth > 1 && ((board.legalMoves(side) >> best->square) & 1))
+  {
+    firstDepth = max(1, min(startDepth, maxDepth));
+    score = expectedScore;
+    previousScore = expectedScore;
+  }
+  int lastMs = 0; // how long the last two iterations took
+  int previousMs = 0;
+  for (int depth = firstDepth; depth <= maxDepth; depth++)
+  {
+    // the first iteration always runs so that there is a move to return
+    if (depth > firstDepth && timer != nullptr
+     && !timer->shouldStartIteration(nextIterationMs(lastMs, previousMs)))
+    {
+      break;
+    }
+    int iterationStart = (timer != nullptr) ? timer->elapsedMs() : 0;
+    int searchDepth = min(maxDepth, depth + (threadId & 1));
+    // the score rarely moves far from one iteration to the next of the
+    // same parity (searches ending on our move tend to look better than
+    // ones ending on the opponent's), so search a narrow window around the
+    // score from two iterations ago first and only widen it when the score
+    // falls outside
+    int alpha = -INF_SCORE;
+    int beta = INF_SCORE;
+    int delta = ASPIRATION_WINDOW;
+    if (depth >= ASPIRATION_MIN_DEPTH)
+    {
+      alpha = max(-INF_SCORE, previousScore - delta);
+      beta = min(INF_SCORE, previousScore + delta);
+    }
+    Move move = *best;
+    int iterationScore;
+    while (true)
+    {
+      iterationScore = searchRoot(board, side, searchDepth, &move, alpha,
+                                  beta);
+      if (aborted || (iterationScore > alpha && iterationScore < beta))
+      {
+        break;
+      }
+      delta *= 2;
+      if (iterationScore <= alpha)
+      {
+        alpha = max(-INF_SCORE, iterationScore - delta);
+      }
+      else
+      {
+        beta = min(INF_SCORE, iterationScore + delta);
+      }
+    }
+    if (aborted)
+    {
+      break; // keep the result of the last completed iteration
+    }
+    *best = move;
+    previousScore = score;
+    score = iterationScore;
+    if (timer != nullptr)
+    {
+      previousMs = lastMs;
+      lastMs = timer->elapsedMs() - iterationStart;
+    }
+    completedDepth = searchDepth;
+    bestLineLength = pvLength[0];
+    for (int i = 0; i < bestLineLength; i++)
+    {
+      bestLine[i] = pv[0][i];
+    }
+    if (onIteration)
+    {
+      onIteration(*this, score);
+    }
+  }
+  return score;
+}
+
+int Search::searchRoot(const Board &board, Side side, int depth, Move *best,
+                       int alpha, int beta)
+{
+  assert(depth > 0);
+  uint64_t legal = board.legalMoves(side);
+  assert(legal != 0); // the caller handles passing
+  int originalAlpha = alpha;
+  nodes++;
+  pvLength[0] = 0;
+  // search the move passed in first, which during iterative deepening is
+  // the best move of the previous iteration
+  int ttMove = ((legal >> best->square) & 1) ? best->square : NO_MOVE;
+  if (eval != nullptr)
+  {
+    eval->initState(board, &evalStates[0]);
+  }
+  int moves[MAX_MOVES];
+  int count = orderMoves(board, side, legal, ttMove, depth, 0, moves);
+  int bestScore = -INF_SCORE;
+  int bestSquare = moves[0];
+  for (int i = 0; i < count; i++)
+  {
+    Board child;
+    makeChild(board, side, moves[i], 0, &child);
+    int score = pvsChild(child, flip(side), depth - 1, alpha, beta, 1,
+                         i == 0);
+    if (aborted)
+    {
+      return 0;
+    }
+    if (score > bestScore)
+    {
+      bestScore = score;
+      bestSquare = moves[i];
+      if (score > alpha)
+      {
+        alpha = score;
+        updatePV(0, moves[i]);
+        if (alpha >= beta)
+        {
+          break; // fail high; the caller widens the window
+        }
+      }
+    }
+  }
+  // after a fail low every move is only known to be no better than alpha,
+  // so there is no best move to report
+  if (bestScore > originalAlpha)
+  {
+    best->square = bestSquare;
+  }
+  if (tt != nullptr)
+  {
+    Bound bound = (bestScore >= beta) ? BOUND_LOWER
+                : (bestScore > originalAlpha) ? BOUND_EXACT : BOUND_UPPER;
+    tt->store(board.getKey(side), depth, bound, bestScore, bestSquare);
+  }
+  return bestScore;
+}
+
+// returns the score of the board for the side to move, searched to the given
+// depth. scores outside (alpha, beta) are only bounds.
+int Search::negamax(const Board &board, Side side, int depth,
+                    int alpha, int beta, int ply)
+{
+  nodes++;
+  // checking the clock is comparatively slow, so only do it now and then
+  if ((nodes & 1023) == 0 && timer != nullptr && timer->outOfTime())
+  {
+    aborted = true;
+  }
+  if (stop != nullptr && stop->load(memory_order_relaxed))
+  {
+    aborted = true;
+  }
+  if (aborted)
+  {
+    return 0;
+  }
+  assert(ply < MAX_PLY);
+  pvLength[ply] = ply;
+  if (depth == 0)
+  {
+    // a full board is a finished game, so score it exactly. this makes a
+    // search as deep as the number of empties an exact solve
+    if (board.countEmpty() == 0)
+    {
+      return finalScore(board, side);
+    }
+    return (eval != nullptr) ? eval->evaluate(board, side, evalStates[ply])
+                             : evaluate(board, side);
+  }
+  uint64_t legal = board.legalMoves(side);
+  if (legal == 0)
+  {
+    // no moves: either the game is over or we have to pass. a pass does not
+    // use up depth since it does not branch
+    if (board.legalMoves(flip(side)) == 0)
+    {
+      return finalScore(board, side);
+    }
+    if (eval != nullptr)
+    {
+      evalStates[ply + 1] = evalStates[ply];
+    }
+    int score = -negamax(board, flip(side), depth, -beta, -alpha, ply + 1);
+    updatePV(ply, NO_MOVE);
+    return score;
+  }
+  // a stored result that was searched at least as deep can end the search
+  // of this node right away; otherwise its best move is still the best
+  // guess for what to try first
+  uint64_t key = board.getKey(side);
+  int ttMove = NO_MOVE;
+  TTEntry entry;
+  if (tt != nullptr && tt->probe(key, &entry))
+  {
+    if (entry.depth >= depth)
+    {
+      if (entry.bound == BOUND_EXACT
+       || (entry.bound == BOUND_LOWER && entry.score >= beta)
+       || (entry.bound == BOUND_UPPER && entry.score <= alpha))
+      {
+        return entry.score;
+      }
+    }
+    if ((legal >> entry.move) & 1)
+    {
+      ttMove = entry.move;
+    }
+  }
+  // searches that reach the end of the game are left exact, so that their
+  // table entries can be trusted as solves
+  if (probcut != nullptr && probcut->enabled && depth < board.countEmpty())
+  {
+    int score;
+    bool cut = tryProbCut(board, side, depth, alpha, beta, ply, &score);
+    if (aborted)
+    {
+      return 0;
+    }
+    if (cut)
+    {
+      return score;
+    }
+  }
+  int moves[MAX_MOVES];
+  int count = orderMoves(board, side, legal, ttMove, depth, ply, moves);
+  int originalAlpha = alpha;
+  int bestScore = -INF_SCORE;
+  int bestSquare = moves[0];
+  for (int i = 0; i < count; i++)
+  {
+    Board child;
+    makeChild(board, side, moves[i], ply, &child);
+    int score = pvsChild(child, flip(side), depth - 1, alpha, beta, ply + 1,
+                         i == 0);
+    if (aborted)
+    {
+      return 0;
+    }
+    if (score > bestScore)
+    {
+      bestScore = score;
+      bestSquare = moves[i];
+      if (score > alpha)
+      {
+        alpha = score;
+        updatePV(ply, moves[i]);
+        if (alpha >= beta)
+        {
+          // the opponent will never allow this line
+          cutoffs++;
+          firstMoveCutoffs += (i == 0);
+          ordering.recordCutoff(side, ply, depth, moves[i]);
+          break;
+        }
+      }
+    }
+  }
+  if (tt != nullptr)
+  {
+    Bound bound = (bestScore >= beta) ? BOUND_LOWER
+                : (bestScore > originalAlpha) ? BOUND_EXACT : BOUND_UPPER;
+    tt->store(key, depth, bound, bestScore, bestSquare);
+  }
+  return bestScore;
+}
+
+// Multi-ProbCut: predicts the result of searching the board to depth from
+// a shallow search, and if the prediction is confidently outside
+// (alpha, beta) stores the bound it falls beyond in *score and returns true
+bool Search::tryProbCut(const Board &board, Side side, int depth, int alpha,
+                        int beta, int ply, int *score)
+{
+  const ProbCutRegression *r =
+    probcut->regression(ProbCut::phaseOf(board), depth);
+  if (r == nullptr)
+  {
+    return false;
+  }
+  double margin = probcut->threshold * r->sigma;
+  // the deep score is probably at least beta if the shallow one is at least
+  // this high
+  int bound = (int) ceil((beta + margin - r->b) / r->a);
+  if (bound < INF_SCORE)
+  {
+    if (negamax(board, side, r->shallow, bound - 1, bound, ply) >= bound)
+    {
+      probCuts++;
+      *score = beta;
+      return true;
+    }
+  }
+  // and probably at most alpha if the shallow one is at most this low
+  bound = (int) floor((alpha - margin - r->b) / r->a);
+  if (bound > -INF_SCORE && !aborted)
+  {
+    if (negamax(board, side, r->shallow, bound, bound + 1, ply) <= bound)
+    {
+      probCuts++;
+      *score = alpha;
+      return true;
+    }
+  }
+  // the shallow searches used this ply's principal variation
+  pvLength[ply] = ply;
+  return false;
+}
+
+// searches a child of a node with window (alpha, beta) from the parent's
+// point of view and returns its score for the parent. the first child gets
+// the full window; the others are only tested against alpha with a null
+// window and searched again in full if they turn out to be better
+int Search::pvsChild(const Board &child, Side side, int depth, int alpha,
+                     int beta, int ply, bool first)
+{
+  if (first)
+  {
+    return -negamax(child, side, depth, -beta, -alpha, ply);
+  }
+  int score = -negamax(child, side, depth, -alpha - 1, -alpha, ply);
+  if (score > alpha && score < beta && !aborted)
+  {
+    score = -negamax(child, side, depth, -beta, -alpha, ply);
+  }
+  return score;
+}
+
+// plays square in board into *child, and when there is an evaluator brings
+// its state for ply + 1 up to date
+void Search::makeChild(const Board &board, Side side, int square, int ply,
+                       Board *child)
+{
+  uint64_t flips = board.getFlips(square, side);
+  *child = board;
+  child->makeMove(square, side, flips);
+  if (eval != nullptr)
+  {
+    eval->updateState(evalStates[ply], square, flips, side,
+                      &evalStates[ply + 1]);
+  }
+}
+
+// makes square followed by the child's line the principal variation at ply
+void Search::updatePV(int ply, int square)
+{
+  pv[ply][ply] = square;
+  for (int i = ply + 1; i < pvLength[ply + 1]; i++)
+  {
+    pv[ply][i] = pv[ply + 1][i];
+  }
+  pvLength[ply] = pvLength[ply + 1];
+}
+
+// fills moves[] with the legal moves in the order they should be searched
+// and returns how many there are
+int Search::orderMoves(const Board &board, Side side, uint64_t legal,
+                       int ttMove, int depth, int ply, int moves[])
+{
+  int keys[MAX_MOVES];
+  int count = 0;
+  while (legal)
+  {
+    int square = __builtin_ctzll(legal);
+    legal &= legal - 1;
+    int key;
+    if (square == ttMove)
+    {
+      key = TT_MOVE_KEY;
+    }
+    else
+    {
+      key = ordering.quietScore(side, ply, square);
+      if (depth >= ORDER_MOBILITY_DEPTH)
+      {
+        Board child;
+        makeChild(board, side, square, ply, &child);
+        key -= MOBILITY_WEIGHT * child.mobility(flip(side));
+        if (depth >= ORDER_SHALLOW_DEPTH)
+        {
+          // deeper nodes are worth a real, if shallow, look at each move
+          int shallow = (depth - ORDER_SHALLOW_DEPTH) / 4;
+          key -= SHALLOW_WEIGHT * negamax(child, flip(side), shallow,
+                                          -INF_SCORE, INF_SCORE, ply + 1);
+        }
+      }
+    }
+    moves[count] = square;
+    keys[count] = key;
+    count++;
+  }
+  sortMoves(moves, keys, count);
+  return count;
+}
+
+double Search::firstMoveCutoffRate() const
+{
+  return (cutoffs == 0) ? 0.0 : 100.0 * firstMoveCutoffs / cutoffs;
+}
@@ -0,0 +1,110 @@
+#ifndef __SEARCH_H__
+#define __SEARCH_H__
+
+#include <atomic>
+#include <functional>
+#include "common.hpp"
+#include "board.hpp"
+#include "timemanager.hpp"
+#include "tt.hpp"
+#include "ordering.hpp"
+#include "eval.hpp"
+
+class ProbCut;
+
+// Depth-first negamax search with alpha-beta pruning for the Othello AI.
+// Unlike Tree, nothing is materialized: every position lives on the stack
+// as a Board value for as long as its recursive call is active.
+
+using namespace std;
+
+const int INF_SCORE = 1000000;
+const int DISC_WIN_SCALE = 1000; // finished games score the disc difference
+                                 // times this. the pattern evaluator
+                                 // predicts the same quantity; the old
+                                 // heuristic stays well below one disc
+const int MAX_DEPTH = 64;
+
+class Search {
+public:
+  long long nodes; // positions visited since the last reset
+  long long probCuts; // nodes cut by Multi-ProbCut
+  bool aborted; // set when the time manager stopped the search
+  int completedDepth; // depth of the last fully searched iteration
+  long long cutoffs; // beta cutoffs, and how many of them came from the
+  long long firstMoveCutoffs; // first move searched at the node
+  // expected line of play from the last completed iteration, starting with
+  // the best move. NO_MOVE stands for a pass
+  uint8_t bestLine[MAX_PLY];
+  int bestLineLength;
+
+  // for parallel search: the search gives up as soon as *stop becomes true,
+  // and threads with an odd id search each iteration one ply deeper so that
+  // the threads do not all duplicate the same work
+  const atomic<bool> *stop;
+  int threadId;
+
+  // iterative deepening starts at startDepth instead of 1 when the move
+  // passed in is legal, expecting a score near expectedScore. this is for
+  // positions the transposition table already knows from an earlier search
+  int startDepth;
+  int expectedScore;
+
+  // if set, iterativeDeepening calls this after every completed iteration
+  // with the iteration's score. completedDepth, bestLine and nodes are up
+  // to date when it does
+  function<void(const Search &, int)> onIteration;
+
+  // tt may be nullptr to search without a transposition table, eval may be
+  // nullptr to use the Board::getWhiteValue heuristic, and probcut may be
+  // nullptr for a full-width search
+  Search(TranspositionTable *tt = nullptr, const Evaluator *eval = nullptr,
+         const ProbCut *probcut = nullptr);
+  // searches the position to the given depth and stores the best move for
+  // side in *best, trying the move already in *best first. returns the
+  // score from side's point of view; a score at or below alpha or at or
+  // above beta is only a bound, and after a fail low *best is left as it
+  // was. side must have at least one legal move. if the search is aborted,
+  // *best is left as it was and the returned score is meaningless.
+  int searchRoot(const Board &board, Side side, int depth, Move *best,
+                 int alpha = -INF_SCORE, int beta = INF_SCORE);
+  // searches with increasing depth up to maxDepth until the timer says to
+  // stop, and stores the best move of the last completed iteration in *best.
+  // returns that iteration's score. timer may be nullptr for no time limit.
+  // if even the first iteration is cut short, *best is left as it was.
+  int iterativeDeepening(const Board &board, Side side, int maxDepth,
+                         const TimeManager *timer, Move *best);
+  // percentage of beta cutoffs caused by the first move searched, which is
+  // how often move ordering put a refutation first
+  double firstMoveCutoffRate() const;
+
+private:
+  const TimeManager *timer;
+  TranspositionTable *tt;
+  const Evaluator *eval;
+  const ProbCut *probcut;
+  MoveOrdering ordering;
+  // triangular table of principal variations: pv[ply] holds the best line
+  // found from ply on, in pv[ply][ply .. pvLength[ply] - 1]
+  uint8_t pv[MAX_PLY][MAX_PLY];
+  int pvLength[MAX_PLY];
+  // evaluation state of the position being searched at each ply, when
+  // there is an evaluator
+  EvalState evalStates[MAX_PLY];
+
+  int negamax(const Board &board, Side side, int depth, int alpha, int beta,
+              int ply);
+  bool tryProbCut(const Board &board, Side side, int depth, int alpha,
+                  int beta, int ply, int *score);
+  int pvsChild(const Board &child, Side side, int depth, int alpha, int beta,
+               int ply, bool first);
+  void makeChild(const Board &board, Side side, int square, int ply,
+                 Board *child);
+  void updatePV(int ply, int square);
+  int orderMoves(const Board &board, Side side, uint64_t legal, int ttMove,
+                 int depth, int ply, int moves[]);
+};
+
+int evaluate(const Board &board, Side side);
+
+#endif
@@ -0,0 +1,75 @@
+// Lazy SMP parallel search for the Othello AI
+
+#include "smp.hpp"
+#include <algorithm>
+#include <thread>
+#include <vector>
+using namespace std;
+
+ParallelSearch::ParallelSearch(TranspositionTable *tt, const Evaluator *eval,
+                               int threads, const ProbCut *probcut)
+{
+  this->tt = tt;
+  this->eval = eval;
+  this->probcut = probcut;
+  this->threads = max(1, min(threads, MAX_THREADS));
+  nodes = 0;
+  completedDepth = 0;
+  cutoffs = 0;
+  firstMoveCutoffs = 0;
+  bestLineLength = 0;
+  stop = nullptr;
+  startDepth = 1;
+  expectedScore = 0;
+}
+
+int ParallelSearch::iterativeDeepening(const Board &board, Side side,
+                                       int maxDepth, const TimeManager *timer,
+                                       Move *best)
+{
+  atomic<bool> helpersStop(false);
+  Search main(tt, eval, probcut);
+  main.stop = stop;
+  main.startDepth = startDepth;
+  main.expectedScore = expectedScore;
+  vector<Search> helpers(threads - 1, main);
+  main.onIteration = onIteration;
+  vector<Move> helperMoves(threads - 1, *best);
+  vector<thread> pool;
+  for (int i = 0; i < threads - 1; i++)
+  {
+    helpers[i].stop = &helpersStop;
+    helpers[i].threadId = i + 1;
+    // helpers ignore the clock; they run until the main thread is done
+    pool.push_back(thread([&, i]() {
+      helpers[i].iterativeDeepening(board, side, maxDepth, nullptr,
+                                    &helperMoves[i]);
+    }));
+  }
+
+  int score = main.iterativeDeepening(board, side, maxDepth, timer, best);
+  helpersStop.store(true);
+  for (size_t i = 0; i < pool.size(); i++)
+  {
+    pool[i].join();
+  }
+
+  nodes = main.nodes;
+  cutoffs = main.cutoffs;
+  firstMoveCutoffs = main.firstMoveCutoffs;
+  for (size_t i = 0; i < helpers.size(); i++)
+  {
+    nodes += helpers[i].nodes;
+    cutoffs += helpers[i].cutoffs;
+    firstMoveCutoffs += helpers[i].firstMoveCutoffs;
+  }
+  completedDepth = main.completedDepth;
+  bestLineLength = main.bestLineLength;
+  copy(main.bestLine, main.bestLine + bestLineLength, bestLine);
+  return score;
+}
+
+double ParallelSearch::firstMoveCutoffRate() const
+{
+  return (cutoffs == 0) ? 0.0 : 100.0 * firstMoveCutoffs / cutoffs;
+}
@@ -0,0 +1,49 @@
+#ifndef __SMP_H__
+#define __SMP_H__
+
+#include "common.hpp"
+#include "board.hpp"
+#include "search.hpp"
+#include "tt.hpp"
+
+// Lazy SMP: the same iterative deepening search is started on several
+// threads that share one transposition table. The threads speed each other
+// up through the table; the main thread's result is the one that is played,
+// and the helpers are stopped as soon as it finishes.
+
+using namespace std;
+
+const int MAX_THREADS = 64;
+
+class ParallelSearch {
+public:
+  long long nodes; // total positions visited by all threads
+  int completedDepth; // depth of the main thread's last completed iteration
+  long long cutoffs; // beta cutoffs of all threads, and how many came from
+  long long firstMoveCutoffs; // the first move searched
+  uint8_t bestLine[MAX_PLY]; // the main thread's expected line of play
+  int bestLineLength;
+  // the search also stops as soon as *stop becomes true, if stop is set
+  const atomic<bool> *stop;
+  // passed on to every thread's Search
+  int startDepth;
+  int expectedScore;
+  // passed on to the main thread's Search only
+  function<void(const Search &, int)> onIteration;
+
+  ParallelSearch(TranspositionTable *tt, const Evaluator *eval, int threads,
+                 const ProbCut *probcut = nullptr);
+  // same contract as Search::iterativeDeepening
+  int iterativeDeepening(const Board &board, Side side, int maxDepth,
+                         const TimeManager *timer, Move *best);
+  // same as Search::firstMoveCutoffRate, over all threads
+  double firstMoveCutoffRate() const;
+
+private:
+  TranspositionTable *tt;
+  const Evaluator *eval;
+  const ProbCut *probcut;
+  int threads;
+};
+
+#endif
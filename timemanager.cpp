@@ -0,0 +1,68 @@
+// Time manager for the Othello AI
+
+#include "timemanager.hpp"
+#include <algorithm>
+using namespace std;
+
+TimeManager::TimeManager()
+{
+  softLimitMs = -1;
+  hardLimitMs = -1;
+  startTime = chrono::steady_clock::now();
+}
+
+void TimeManager::start(int msLeft, int empties, int overheadMs)
+{
+  startTime = chrono::steady_clock::now();
+  if (msLeft < 0)
+  {
+    softLimitMs = -1;
+    hardLimitMs = -1;
+    return;
+  }
+  // we play about every other remaining square, and each of those moves
+  // costs the driver's overhead, which we can't do anything about. the
+  // time itself goes to the moves before the endgame solver takes over:
+  // whatever the solver leaves over would otherwise go unused
+  int movesLeft = max(1, (empties + 1) / 2);
+  int plannedMoves = movesLeft;
+  if (empties > PLAN_SOLVE_EMPTIES)
+  {
+    plannedMoves = (empties - PLAN_SOLVE_EMPTIES + 1) / 2 + PLAN_SOLVE_MOVES;
+  }
+  int usable = msLeft - CLOCK_RESERVE_MS - movesLeft * overheadMs;
+  usable = max(0, usable);
+  int target = usable / plannedMoves;
+  // no new iteration once the target is used up, or if it is not expected
+  // to finish in time. the hard limit lets an iteration overrun the target,
+  // but not by more than a quarter of what is left unless this is our last
+  // move anyway
+  softLimitMs = target;
+  hardLimitMs = min(target * 2, max(target, usable / 4));
+}
+
+bool TimeManager::unlimited() const
+{
+  return hardLimitMs < 0;
+}
+
+int TimeManager::elapsedMs() const
+{
+  return chrono::duration_cast<chrono::milliseconds>(
+    chrono::steady_clock::now() - startTime).count();
+}
+
+bool TimeManager::shouldStartIteration(int nextIterationMs) const
+{
+  if (unlimited())
+  {
+    return true;
+  }
+  int elapsed = elapsedMs();
+  return elapsed < softLimitMs && elapsed + nextIterationMs <= hardLimitMs;
+}
+
+bool TimeManager::outOfTime() const
+{
+  return !unlimited() && elapsedMs() >= hardLimitMs;
+}
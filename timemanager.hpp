@@ -0,0 +1,44 @@
+#ifndef __TIMEMANAGER_H__
+#define __TIMEMANAGER_H__
+
+#include <chrono>
+
+// Splits the game clock across the moves we still expect to play and tells
+// the search when to stop deepening. Each move gets a soft limit, after which
+// no new iteration is started, and a hard limit, after which the running
+// iteration is abandoned. An iteration is also not started if it is not
+// expected to finish before the hard limit.
+
+using namespace std;
+
+const int MOVE_OVERHEAD_MS = 120; // the java wrapper polls our stdout every
+                                  // 100ms, and that time comes off our clock
+const int MOVE_OVERHEAD_MARGIN_MS = 20; // added to the most overhead seen
+                                        // once there is some to go on
+const int CLOCK_RESERVE_MS = 500; // never plan to use the last of the clock
+const int PLAN_SOLVE_EMPTIES = 20; // from here on the endgame solver plays
+                                   // the moves, and it rarely needs long
+const int PLAN_SOLVE_MOVES = 2; // so all of them together are planned as
+                                // this many midgame moves
+
+class TimeManager {
+public:
+  TimeManager();
+  // starts timing a move. msLeft < 0 means the game is untimed. overheadMs
+  // is what each of our remaining moves costs on the clock besides our own
+  // thinking
+  void start(int msLeft, int empties, int overheadMs = MOVE_OVERHEAD_MS);
+  bool unlimited() const;
+  int elapsedMs() const;
+  // false once the soft limit has passed, or if an iteration expected to
+  // take nextIterationMs would run past the hard limit
+  bool shouldStartIteration(int nextIterationMs) const;
+  bool outOfTime() const; // true once the hard limit has passed
+  int softLimitMs;
+  int hardLimitMs;
+
+private:
+  chrono::steady_clock::time_point startTime;
+};
+
+#endif
@@ -0,0 +1,420 @@
+// Fits the evaluation weights of the Othello AI to labeled positions.
+//
+//   trainer [-epochs N] [-batch N] [-rate R] [-l2 R] [-threads N]
+//           [-start FILE] [-output FILE] DATA...
+//
+// DATA files are either game records (see gamerecord.hpp), whose every
+// position is labeled with the game's final margin, or text with one
+// position per line as written by analyze: the 64 squares in setBoard
+// order, the side to move, and then the label, the first number after the
+// side, in discs for the side to move. Positions where the side to move
+// has to pass, and games that ended by forfeit, are left out.
+//
+// Features come from Evaluator::features, so the fit is of exactly the
+// function the engine evaluates with: the prediction is the sum of one
+// pattern weight per instance plus each whole-board feature weight times
+// its feature, in discs, and the loss is its squared error. Since
+// every phase has weights of its own and every position belongs to one
+// phase, the phases are independent problems; they are shared out over
+// -threads workers (default one per core), each running mini-batch
+// gradient descent on its phases. A weight's step is its summed error over
+// the batch divided by the number of times it occurs there, so the rare
+// pattern configurations learn as fast as the common ones, times -rate
+// (default 1) over the number of active features. -l2 (default 0.001)
+// pulls the weights seen in a batch towards 0.
+//
+// The fit starts from the weights in -start, by default the weights file
+// in the current directory if there is one and the built-in weights if
+// not. Every tenth position is held out, and the error on it is printed
+// after every epoch. The weights are written to -output (default
+// othello.weights), which the player loads at startup.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+#include "board.hpp"
+#include "ordering.hpp"
+#include "eval.hpp"
+#include "gamerecord.hpp"
+using namespace std;
+
+const int DEFAULT_EPOCHS = 20;
+const int DEFAULT_BATCH = 4096;
+const double DEFAULT_RATE = 1;
+const double DEFAULT_L2 = 0.001;
+const int HOLDOUT_EVERY = 10;
+const int ACTIVE_FEATURES = EVAL_INSTANCES + EVAL_BOARD_FEATURES;
+
+// the positions of one phase, as a dense matrix: position j's pattern
+// features are features[j * EVAL_INSTANCES ...] and its whole-board ones
+// boardFeatures[j * EVAL_BOARD_FEATURES ...]
+struct PhaseData {
+  vector<int32_t> features;
+  vector<float> boardFeatures;
+  vector<float> target; // in discs
+  size_t size() const {return target.size();}
+};
+
+struct TrainOptions {
+  int epochs;
+  int batch;
+  double rate;
+  double l2;
+};
+
+// everything read so far: training and held-out positions by phase
+struct TrainingSet {
+  PhaseData train[EVAL_PHASES];
+  PhaseData holdout[EVAL_PHASES];
+  long long count;
+};
+
+static void addPosition(const Evaluator &eval, const Board &board,
+                        Side side, double label, TrainingSet *set)
+{
+  int f[EVAL_INSTANCES];
+  int b[EVAL_BOARD_FEATURES];
+  int phase = eval.features(board, side, f, b);
+  PhaseData &data = (set->count++ % HOLDOUT_EVERY == HOLDOUT_EVERY - 1)
+                  ? set->holdout[phase] : set->train[phase];
+  data.features.insert(data.features.end(), f, f + EVAL_INSTANCES);
+  data.boardFeatures.insert(data.boardFeatures.end(), b,
+                            b + EVAL_BOARD_FEATURES);
+  data.target.push_back(label);
+}
+
+// reads every position of every game in a record file. returns false if it
+// is not a record file
+static bool readRecords(const char *path, const Evaluator &eval,
+                        TrainingSet *set)
+{
+  RecordReader reader;
+  if (!reader.open(path))
+  {
+    return false;
+  }
+  GameView game;
+  while (reader.next(&game))
+  {
+    if (game.header.flags & RECORD_FORFEIT)
+    {
+      continue;
+    }
+    Board board;
+    Side side = BLACK;
+    for (int i = 0; i < game.header.plies; i++)
+    {
+      int square = game.moves[i];
+      if (square != NO_MOVE)
+      {
+        uint64_t flips = (square < NO_MOVE) ? board.getFlips(square, side)
+                                            : 0;
+        if (flips == 0 || !((board.emptySquares() >> square) & 1))
+        {
+          break; // a damaged game; keep what came before
+        }
+        addPosition(eval, board, side,
+                    (side == BLACK) ? game.header.margin
+                                    : -game.header.margin, set);
+        board.makeMove(square, side, flips);
+      }
+      side = flip(side);
+    }
+  }
+  if (reader.damaged)
+  {
+    fprintf(stderr, "%s is damaged; using the games before the damage\n",
+            path);
+  }
+  return true;
+}
+
+// reads labeled positions from a text file. returns false if it cannot be
+// read
+static bool readText(const char *path, const Evaluator &eval,
+                     TrainingSet *set)
+{
+  FILE *file = fopen(path, "r");
+  if (file == nullptr)
+  {
+    return false;
+  }
+  char line[1024];
+  while (fgets(line, sizeof(line), file) != nullptr)
+  {
+    if (strlen(line) < 66 || line[64] != ' '
+     || (line[65] != 'b' && line[65] != 'w'))
+    {
+      continue;
+    }
+    // the label is the first field after the side that is a number
+    char *field = strtok(line + 66, " \t\r\n");
+    double label = 0;
+    bool found = false;
+    while (field != nullptr && !found)
+    {
+      char *end;
+      label = strtod(field, &end);
+      found = end != field && *end == 0;
+      field = strtok(nullptr, " \t\r\n");
+    }
+    Board board;
+    Side side = (line[65] == 'b') ? BLACK : WHITE;
+    board.setBoard(line);
+    if (found && board.hasMoves(side))
+    {
+      addPosition(eval, board, side, label, set);
+    }
+  }
+  fclose(file);
+  return true;
+}
+
+// the prediction for position j of data, in discs. w is the phase's weights
+static inline double predict(const PhaseData &data, size_t j,
+                             const float *w)
+{
+  const int32_t *f = &data.features[j * EVAL_INSTANCES];
+  const float *b = &data.boardFeatures[j * EVAL_BOARD_FEATURES];
+  const float *boardWeights = w + Evaluator::boardWeightIndex();
+  double sum = 0;
+  for (int k = 0; k < EVAL_BOARD_FEATURES; k++)
+  {
+    sum += b[k] * boardWeights[k];
+  }
+  for (int i = 0; i < EVAL_INSTANCES; i++)
+  {
+    sum += w[f[i]];
+  }
+  return sum;
+}
+
+static double squaredError(const PhaseData &data, const float *w)
+{
+  double total = 0;
+  for (size_t j = 0; j < data.size(); j++)
+  {
+    double r = data.target[j] - predict(data, j, w);
+    total += r * r;
+  }
+  return total;
+}
+
+// one epoch of mini-batch gradient descent over a phase's positions, in
+// the order given. gradient and count are scratch arrays of the phase's
+// size, all zero on entry and on return
+static void trainEpoch(const PhaseData &data, const vector<uint32_t> &order,
+                       const TrainOptions &options, float *w,
+                       float *gradient, float *count)
+{
+  int boardIndex = Evaluator::boardWeightIndex();
+  vector<int32_t> touched;
+  double step = options.rate / ACTIVE_FEATURES;
+  for (size_t start = 0; start < order.size(); start += options.batch)
+  {
+    size_t end = min(order.size(), start + (size_t) options.batch);
+    touched.clear();
+    for (size_t n = start; n < end; n++)
+    {
+      size_t j = order[n];
+      float r = data.target[j] - predict(data, j, w);
+      const int32_t *f = &data.features[j * EVAL_INSTANCES];
+      for (int i = 0; i < EVAL_INSTANCES; i++)
+      {
+        if (count[f[i]] == 0)
+        {
+          touched.push_back(f[i]);
+        }
+        gradient[f[i]] += r;
+        count[f[i]] += 1;
+      }
+      const float *b = &data.boardFeatures[j * EVAL_BOARD_FEATURES];
+      for (int k = 0; k < EVAL_BOARD_FEATURES; k++)
+      {
+        if (count[boardIndex + k] == 0)
+        {
+          touched.push_back(boardIndex + k);
+        }
+        // these scale with their feature, so they step by the feature's
+        // squared size
+        gradient[boardIndex + k] += r * b[k];
+        count[boardIndex + k] += b[k] * b[k] + 1e-3f;
+      }
+    }
+    for (size_t t = 0; t < touched.size(); t++)
+    {
+      int k = touched[t];
+      w[k] += step * (gradient[k] / count[k] - options.l2 * w[k]);
+      gradient[k] = 0;
+      count[k] = 0;
+    }
+  }
+}
+
+// writes the fitted weights as the engine's int16s
+static void quantize(const vector<float> &fitted, Evaluator *eval)
+{
+  for (size_t k = 0; k < fitted.size(); k++)
+  {
+    double w = lround(fitted[k] * WEIGHT_SCALE);
+    eval->weights[k] = (int16_t) max(-32768.0, min(32767.0, w));
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  TrainOptions options;
+  options.epochs = DEFAULT_EPOCHS;
+  options.batch = DEFAULT_BATCH;
+  options.rate = DEFAULT_RATE;
+  options.l2 = DEFAULT_L2;
+  int threads = max(1, (int) thread::hardware_concurrency());
+  const char *startPath = DEFAULT_WEIGHTS_FILE;
+  const char *outputPath = DEFAULT_WEIGHTS_FILE;
+  bool ok = true;
+  int i = 1;
+  for (; ok && i + 1 < argc && argv[i][0] == '-'; i += 2)
+  {
+    const char *value = argv[i + 1];
+    if (!strcmp(argv[i], "-epochs"))
+    {
+      options.epochs = atoi(value);
+      ok = options.epochs >= 0;
+    }
+    else if (!strcmp(argv[i], "-batch"))
+    {
+      options.batch = atoi(value);
+      ok = options.batch > 0;
+    }
+    else if (!strcmp(argv[i], "-rate"))
+    {
+      options.rate = atof(value);
+      ok = options.rate > 0;
+    }
+    else if (!strcmp(argv[i], "-l2"))
+    {
+      options.l2 = atof(value);
+      ok = options.l2 >= 0;
+    }
+    else if (!strcmp(argv[i], "-threads"))
+    {
+      threads = atoi(value);
+      ok = threads > 0;
+    }
+    else if (!strcmp(argv[i], "-start")) {startPath = value;}
+    else if (!strcmp(argv[i], "-output")) {outputPath = value;}
+    else {ok = false;}
+  }
+  if (!ok || i == argc)
+  {
+    fprintf(stderr, "usage: %s [-epochs N] [-batch N] [-rate R] [-l2 R] "
+                    "[-threads N] [-start FILE] [-output FILE] DATA...\n",
+            argv[0]);
+    return 1;
+  }
+
+  Evaluator eval;
+  if (eval.load(startPath))
+  {
+    fprintf(stderr, "starting from %s\n", startPath);
+  }
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  TrainingSet *set = new TrainingSet();
+  set->count = 0;
+  for (; i < argc; i++)
+  {
+    if (!readRecords(argv[i], eval, set) && !readText(argv[i], eval, set))
+    {
+      fprintf(stderr, "could not read %s\n", argv[i]);
+      return 1;
+    }
+  }
+  fprintf(stderr, "%lld positions read in %.1f s\n", set->count,
+          chrono::duration<double>(chrono::steady_clock::now()
+                                   - start).count());
+  if (set->count == 0)
+  {
+    return 1;
+  }
+
+  int perPhase = Evaluator::weightsPerPhase();
+  vector<float> fitted(eval.weights.size());
+  for (size_t k = 0; k < fitted.size(); k++)
+  {
+    fitted[k] = (float) eval.weights[k] / WEIGHT_SCALE;
+  }
+  long long trainCount = 0, holdoutCount = 0;
+  for (int p = 0; p < EVAL_PHASES; p++)
+  {
+    trainCount += set->train[p].size();
+    holdoutCount += set->holdout[p].size();
+  }
+  for (int epoch = 0; epoch <= options.epochs; epoch++)
+  {
+    // epoch 0 only measures the starting weights
+    double trainError[EVAL_PHASES];
+    double holdoutError[EVAL_PHASES];
+    atomic<int> next(0);
+    vector<thread> workers;
+    for (int t = 0; t < min(threads, EVAL_PHASES); t++)
+    {
+      workers.push_back(thread([&]() {
+        vector<float> gradient(perPhase, 0);
+        vector<float> count(perPhase, 0);
+        vector<uint32_t> order;
+        for (int p = next++; p < EVAL_PHASES; p = next++)
+        {
+          const PhaseData &data = set->train[p];
+          float *w = &fitted[p * perPhase];
+          if (epoch > 0)
+          {
+            // the shuffle depends only on the phase and epoch, so the fit
+            // is the same with any number of threads
+            order.resize(data.size());
+            for (size_t j = 0; j < order.size(); j++)
+            {
+              order[j] = j;
+            }
+            mt19937 generator(epoch * EVAL_PHASES + p);
+            shuffle(order.begin(), order.end(), generator);
+            trainEpoch(data, order, options, w, &gradient[0], &count[0]);
+          }
+          trainError[p] = squaredError(data, w);
+          holdoutError[p] = squaredError(set->holdout[p], w);
+        }
+      }));
+    }
+    for (size_t t = 0; t < workers.size(); t++)
+    {
+      workers[t].join();
+    }
+    double trainTotal = 0, holdoutTotal = 0;
+    for (int p = 0; p < EVAL_PHASES; p++)
+    {
+      trainTotal += trainError[p];
+      holdoutTotal += holdoutError[p];
+    }
+    fprintf(stderr, "epoch %2d: rms error %.3f discs, held out %.3f discs, "
+                    "%.1f s\n", epoch,
+            sqrt(trainTotal / max(1LL, trainCount)),
+            sqrt(holdoutTotal / max(1LL, holdoutCount)),
+            chrono::duration<double>(chrono::steady_clock::now()
+                                     - start).count());
+  }
+
+  quantize(fitted, &eval);
+  if (!eval.save(outputPath))
+  {
+    fprintf(stderr, "could not write %s\n", outputPath);
+    return 1;
+  }
+  fprintf(stderr, "wrote %s\n", outputPath);
+  return 0;
+}
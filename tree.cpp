@@ -6,61 +6,55 @@
 using namespace std;
 
 // this function returns the list of allowed moves for the board
-vector<Move> getAllowedMoves(Board * board, Side side)
+vector<Move> getAllowedMoves(const Board &board, Side side)
 {
   vector<Move> moves;
-  for (int i = 0; i < 8; i++)
+  // the legal moves all come out of a single bitboard pass; we then just
+  // peel off the set bits one at a time
+  uint64_t legal = board.legalMoves(side);
+  while (legal)
   {
-    for (int j = 0; j < 8; j++)
-    {
-      Move move(i,j);
-      if (board->checkMove(&move, side))
-      {
-        // then it is a valid move.
-        moves.push_back(move);
-      }
-    }
+    int square = __builtin_ctzll(legal);
+    legal &= legal - 1;
+    moves.push_back(Move(square % 8, square / 8));
   }
   return moves;
 }
 
-Side flip(Side side) 
-{
-  if (side == Side::WHITE) {return Side::BLACK;}
-  else {return Side::WHITE;}
-}
-
 Node::Node()
 {
 // constructor for Node
-board = nullptr;
-lastMove = new Move(-1, -1);
 depth = 0;
+parent = nullptr;
 }
 
 void Node::growNode(int numGen) 
 {
   assert(numGen > -1);
-  if (numGen == 0 || board->isDone()) 
+  if (numGen == 0 || board.isDone()) 
   {
     // then there is no need to grow further children
     return;
   }
   Side side = nextToPlay;
   assert(children.empty()); // ensure that this is a node without children
-  vector<Move> moves = getAllowedMoves(board, side);
+  // walk the legal move mask directly rather than building a move list
+  uint64_t legal = board.legalMoves(side);
+  children.reserve(__builtin_popcountll(legal));
   Node * temp;
   
-  for (int i = 0; i < (int) moves.size(); i++)
+  while (legal)
   {
+    int square = __builtin_ctzll(legal);
+    legal &= legal - 1;
     temp = new Node();
-    temp->board = board->copy();
-    // perform the possible move
-    (temp->board)->doMove(&(moves[i]), side);
-    //cerr << "after move is performed, W B is " << temp->board->countWhite()
-    //     << " " << temp->board->countBlack() << endl;
-    temp->lastMove->x = moves[i].x;
-    temp->lastMove->y = moves[i].y;
+    temp->board = board; // plain value copy of the parent's board
+    // perform the possible move. it came from the legal move mask, so
+    // skip revalidating it
+    temp->board.makeMove(square, side);
+    //cerr << "after move is performed, W B is " << temp->board.countWhite()
+    //     << " " << temp->board.countBlack() << endl;
+    temp->lastMove.square = square;
     temp->depth = depth + 1;
     temp->parent = this;
     temp->nextToPlay = flip(side);
@@ -82,16 +76,16 @@ int Node::getNodeScore(Side mySide)
   if (children.empty()) 
   {
     // then just return the score of the current board
-    // int numWhite = board->countWhite();
-    // int numBlack = board->countBlack();
+    // int numWhite = board.countWhite();
+    // int numBlack = board.countBlack();
     int score;
     if (mySide == Side::WHITE) 
     {
-      score = board->getWhiteValue();
+      score = board.getWhiteValue();
     }
     else 
     {
-      score = -board->getWhiteValue();
+      score = -board.getWhiteValue();
     }
     return score;
   }
@@ -134,15 +128,15 @@ int Node::getNodeScore(Side mySide)
 Node::~Node() 
 {
   //cerr << "beginning of node release, depth = " << depth << endl;
-  //cerr << "W and B count: " << board->countWhite() << " " 
-    //   << board->countBlack() << endl;
+  //cerr << "W and B count: " << board.countWhite() << " " 
+    //   << board.countBlack() << endl;
   if (!children.empty())
   {
   // delete items associated with children
     vector<Node*>::iterator it;
     for (it = children.begin(); it != children.end(); it++) 
     {
-      (*it)->~Node();
+      delete *it;
     }
   //cerr << "emptied children" << endl;
   }
@@ -163,18 +157,8 @@ Node::~Node()
     cerr << "updated parent" << endl;
   }
   */
-  // finally delete the items associated with "node" itself
-  if (board != nullptr) 
-  {
-    //cerr << "trying to delete board" << endl;
-    // check if the board exists
-    //cerr << "this board has black count " << board->countBlack() << endl;
-    //cerr << "this board has white count " << board->countWhite() << endl;
-    //cerr << "this board is done? " << board->isDone() << endl;
-    delete board;
-    //cerr << "board deleted" << endl;
-  }
-  if (lastMove != nullptr) {delete lastMove;}
+  // the board and last move are held by value, so there is nothing else
+  // to release for this node itself
   //cerr << "end of node release" << endl;
 }
 
@@ -182,16 +166,14 @@ Tree::Tree()
 {
   root = nullptr;
   currentDepth = 0;
-  bestMove = new Move(-1, -1);
 }
 
 Tree::~Tree() 
 {
   //cerr << "beginning of tree release" << endl;
   if (root != nullptr) {
-    root->~Node();
+    delete root;
   }
-  delete bestMove;
   //cerr << "end of tree release" << endl;
 }
 
@@ -205,7 +187,7 @@ void Tree::growTree(int numGen)
 Move * Tree::getBestMove(Side side) 
 {
   // before calling this function, the tree must have already been grown!
-  if (!(root->board)->hasMoves(side))
+  if (!root->board.hasMoves(side))
   {
     // if the root board has no moves, there isn't a best move
     return nullptr;
@@ -222,13 +204,12 @@ Move * Tree::getBestMove(Side side)
       testmax = (*it)->getNodeScore(side);
       if (testmax > max) 
       {
-        bestMove->x = ((*it)->lastMove)->x;
-        bestMove->y = ((*it)->lastMove)->y;
+        bestMove = (*it)->lastMove;
         max = testmax;
       }
     }
     assert(max != -1000000); // ensure that min has been updated
     // return the move associated with the minimum gain
-    return bestMove; 
+    return &bestMove; 
   }
 }
@@ -13,8 +13,8 @@
 using namespace std;
 
 struct Node {
-  Board * board;
-  Move * lastMove; // move that produced the current board
+  Board board; // held by value; boards are only 16 bytes
+  Move lastMove; // move that produced the current board
   int depth; // the iteration depth. depth = 0 is the board to be evaluated
   Node * parent;
   vector<Node*> children;
@@ -34,8 +34,7 @@ struct Node {
                                             //board in a particular node
 
 // Some board operations
-  vector<Move> getAllowedMoves(Board * board, Side side);
-  Side flip(Side side);
+  vector<Move> getAllowedMoves(const Board &board, Side side);
 
 class Tree {
 public:
@@ -43,7 +42,7 @@ public:
   Node * root;
   Tree();
   ~Tree();
-  Move * bestMove;
+  Move bestMove;
   void growTree(int numGens);
   Move * getBestMove(Side side); // returns the best move. tree must have been
                                // already grown! 
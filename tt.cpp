@@ -0,0 +1,161 @@
+// Transposition table for the Othello AI
+
+#include "tt.hpp"
+#include <cstdlib>
+#include <new>
+using namespace std;
+
+const int TT_AGE_PLIES = 4; // each generation an entry is old makes it
+                            // count as this much shallower for replacement
+
+// layout of an entry's data word. a data word of zero is an empty slot,
+// which works out because BOUND_NONE is zero
+static inline uint64_t pack(int depth, Bound bound, int score, int move,
+                            uint8_t generation)
+{
+  return (uint64_t) (uint32_t) score
+       | ((uint64_t) (uint8_t) move << 32)
+       | ((uint64_t) (uint8_t) depth << 40)
+       | ((uint64_t) (uint8_t) bound << 48)
+       | ((uint64_t) generation << 56);
+}
+
+static inline TTEntry unpack(uint64_t data)
+{
+  TTEntry entry;
+  entry.score = (int32_t) (uint32_t) data;
+  entry.move = (uint8_t) (data >> 32);
+  entry.depth = (int8_t) (uint8_t) (data >> 40);
+  entry.bound = (uint8_t) (data >> 48);
+  return entry;
+}
+
+TranspositionTable::TranspositionTable(int sizeMB)
+{
+  count = 0;
+  generation = 0;
+  resize(sizeMB);
+}
+
+void TranspositionTable::resize(int sizeMB)
+{
+  // round down to a power of two number of buckets so that the index is a
+  // simple mask of the key
+  size_t bytes = (size_t) (sizeMB > 0 ? sizeMB : 1) << 20;
+  size_t n = 1;
+  while (n * 2 * sizeof(TTBucket) <= bytes)
+  {
+    n *= 2;
+  }
+  if (n != count)
+  {
+    buckets.reset(); // free the old table before allocating the new one
+    // new does not align to more than 16 bytes before C++17. if there is
+    // not the memory, make do with a smaller table
+    void *memory = nullptr;
+    while (posix_memalign(&memory, sizeof(TTBucket), n * sizeof(TTBucket))
+           != 0 && n > 1)
+    {
+      n /= 2;
+    }
+    TTBucket *table = (TTBucket *) memory;
+    for (size_t i = 0; i < n; i++)
+    {
+      new (&table[i]) TTBucket();
+    }
+    buckets.reset(table);
+    count = n;
+  }
+  clear();
+}
+
+void TTFree::operator()(TTBucket *buckets) const
+{
+  free(buckets);
+}
+
+void TranspositionTable::clear()
+{
+  for (size_t i = 0; i < count; i++)
+  {
+    for (int j = 0; j < TT_BUCKET_SIZE; j++)
+    {
+      buckets[i].slots[j].check.store(0, memory_order_relaxed);
+      buckets[i].slots[j].data.store(0, memory_order_relaxed);
+    }
+  }
+}
+
+bool TranspositionTable::probe(uint64_t key, TTEntry *entry) const
+{
+  const TTBucket &bucket = buckets[key & (count - 1)];
+  for (int i = 0; i < TT_BUCKET_SIZE; i++)
+  {
+    uint64_t data = bucket.slots[i].data.load(memory_order_relaxed);
+    uint64_t check = bucket.slots[i].check.load(memory_order_relaxed);
+    if (data != 0 && (check ^ data) == key)
+    {
+      *entry = unpack(data);
+      return true;
+    }
+  }
+  return false;
+}
+
+void TranspositionTable::store(uint64_t key, int depth, Bound bound,
+                               int score, int move)
+{
+  TTBucket &bucket = buckets[key & (count - 1)];
+  // reuse the entry for this position if there is one, otherwise evict the
+  // shallowest entry in the bucket, after aging
+  TTSlot *victim = &bucket.slots[0];
+  int victimDepth = 1000;
+  for (int i = 0; i < TT_BUCKET_SIZE; i++)
+  {
+    TTSlot *slot = &bucket.slots[i];
+    uint64_t data = slot->data.load(memory_order_relaxed);
+    uint64_t check = slot->check.load(memory_order_relaxed);
+    if (data != 0 && (check ^ data) == key)
+    {
+      // a shallower bound from this search, such as a ProbCut verification
+      // or an ordering search, does not replace a deeper result; only its
+      // move, which is the more recent idea of what is best, is kept
+      TTEntry old = unpack(data);
+      if (old.depth > depth && (uint8_t) (data >> 56) == generation
+       && bound != BOUND_EXACT)
+      {
+        data = (data & ~(0xffULL << 32)) | ((uint64_t) (uint8_t) move << 32);
+        slot->check.store(key ^ data, memory_order_relaxed);
+        slot->data.store(data, memory_order_relaxed);
+        return;
+      }
+      victim = slot;
+      break;
+    }
+    if (data == 0)
+    {
+      victim = slot;
+      break;
+    }
+    uint8_t age = generation - (uint8_t) (data >> 56);
+    int slotDepth = unpack(data).depth - TT_AGE_PLIES * age;
+    if (slotDepth < victimDepth)
+    {
+      victim = slot;
+      victimDepth = slotDepth;
+    }
+  }
+  uint64_t data = pack(depth, bound, score, move, generation);
+  victim->check.store(key ^ data, memory_order_relaxed);
+  victim->data.store(data, memory_order_relaxed);
+}
+
+void TranspositionTable::newSearch()
+{
+  generation++;
+}
+
+size_t TranspositionTable::sizeBytes() const
+{
+  return count * sizeof(TTBucket);
+}
@@ -0,0 +1,76 @@
+#ifndef __TT_H__
+#define __TT_H__
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+
+// Fixed-size transposition table for the search. Positions are looked up by
+// their Zobrist key. The table is split into 64-byte buckets of four entries
+// so that a probe touches a single cache line; within a bucket, the entry
+// with the shallowest search is the one that gets replaced, where entries
+// left over from earlier moves count as shallower the older they are. A
+// position already in the table keeps its entry when a shallower, inexact
+// result from the same search is stored for it, apart from the best move.
+//
+// The table is shared by all search threads without locks. Each entry is
+// two words, the packed data and the key XORed with that data, so an entry
+// torn by two threads writing at once no longer matches its key and is
+// simply treated as missing.
+
+using namespace std;
+
+const int DEFAULT_TT_MB = 64;
+
+enum Bound {
+  BOUND_NONE, BOUND_UPPER, BOUND_LOWER, BOUND_EXACT
+};
+
+// the unpacked contents of an entry
+struct TTEntry {
+  int32_t score;
+  uint8_t move; // best move found, as a square index
+  int8_t depth;
+  uint8_t bound; // one of Bound
+};
+
+struct TTSlot {
+  atomic<uint64_t> check; // key ^ data
+  atomic<uint64_t> data;
+};
+
+const int TT_BUCKET_SIZE = 4;
+
+// one cache line; the table is allocated on a cache line boundary
+struct alignas(64) TTBucket {
+  TTSlot slots[TT_BUCKET_SIZE];
+};
+
+static_assert(sizeof(TTBucket) == 64, "a bucket is one cache line");
+
+// frees a table allocated with posix_memalign
+struct TTFree {
+  void operator()(TTBucket *buckets) const;
+};
+
+class TranspositionTable {
+public:
+  TranspositionTable(int sizeMB = DEFAULT_TT_MB);
+  void resize(int sizeMB); // also clears the table
+  void clear();
+  // copies the entry for key into *entry and returns true if there is one
+  bool probe(uint64_t key, TTEntry *entry) const;
+  void store(uint64_t key, int depth, Bound bound, int score, int move);
+  size_t sizeBytes() const;
+  // starts a new generation. entries stored before are kept, but give way
+  // to newer ones. call this between moves, not during a search
+  void newSearch();
+
+private:
+  unique_ptr<TTBucket[], TTFree> buckets;
+  size_t count; // number of buckets; always a power of two
+  uint8_t generation;
+};
+
+#endif
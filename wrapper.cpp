@@ -1,19 +1,258 @@
 #include <iostream>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <unistd.h>
 #include "player.hpp"
 using namespace std;
 
+// The default protocol is one line per move each way: the java wrapper
+// sends "x y msLeft", with x and y the opponent's move or -1 -1 for the
+// first move or a pass, and the player answers "x y", or -1 -1 to pass.
+//
+// "-protocol extended" selects a protocol for drivers that play many games
+// with one process and want to follow the search. The player still starts
+// with "Init done"; after that it reads these commands, one per line:
+//
+//   newgame black|white [MOVES]
+//       start a new game as the given side, from the position after the
+//       opening MOVES if given (written like "f5d6c3d3"); answers "ready"
+//   move X Y MSLEFT
+//       as in the default protocol; answers with any number of
+//         info depth D score S nodes N nps N time MS pv MOVES
+//       lines, one per completed iteration and a last one with the totals,
+//       then "bestmove X Y", followed by " ponder X Y" if the player goes
+//       on to ponder on that reply. scores are in thousandths of a disc,
+//       pv moves are written like "f5", and "pass" is a pass
+//   ponderhit MSLEFT
+//       the opponent played the reply named by the last "ponder"; the same
+//       as sending that move with "move"
+//   stop
+//       stop the current search and answer with its best move so far, or,
+//       if there is none, stop the ponder search without an answer. a
+//       later "ponderhit" still plays the pondered reply, only without
+//       the head start
+//   quit
+//
+// Input and output go straight to the file descriptors, a line per write,
+// so a driver can block on the pipe instead of polling it, and a search
+// runs on its own thread so that "stop" is read while it does.
+
+// Plays the moves, alternately for black and white, on the player's board.
+static bool playOpening(Player *player, const char *moves) {
+    Side side = BLACK;
+    for (const char *c = moves; c[0] != 0; c += 2) {
+        if (c[1] == 0) {
+            return false;
+        }
+        int x = c[0] - 'a';
+        int y = c[1] - '1';
+        if (x < 0 || x > 7 || y < 0 || y > 7) {
+            return false;
+        }
+        Move move(x, y);
+        if (!player->board.checkMove(&move, side)) {
+            return false;
+        }
+        player->board.doMove(&move, side);
+        side = flip(side);
+    }
+    return true;
+}
+
+// Writes the whole line and its newline to stdout in one write.
+static void writeLine(string line) {
+    line += '\n';
+    const char *data = line.data();
+    size_t left = line.size();
+    while (left > 0) {
+        ssize_t written = write(1, data, left);
+        if (written <= 0) {
+            return;
+        }
+        data += written;
+        left -= written;
+    }
+}
+
+// Reads a line from stdin, without its newline. Returns false at the end
+// of the input.
+static bool readLine(string *buffered, string *line) {
+    while (true) {
+        size_t newline = buffered->find('\n');
+        if (newline != string::npos) {
+            *line = buffered->substr(0, newline);
+            buffered->erase(0, newline + 1);
+            return true;
+        }
+        char data[4096];
+        ssize_t got = read(0, data, sizeof(data));
+        if (got <= 0) {
+            return false;
+        }
+        buffered->append(data, got);
+    }
+}
+
+// Names a square like "f5", or "pass" for NO_MOVE.
+static string squareName(int square) {
+    if (square == NO_MOVE) {
+        return "pass";
+    }
+    string name;
+    name += (char) ('a' + (square & 7));
+    name += (char) ('1' + (square >> 3));
+    return name;
+}
+
+static void writeInfo(const SearchInfo &info) {
+    char text[160];
+    long long nps = (info.ms > 0) ? info.nodes * 1000 / info.ms : 0;
+    snprintf(text, sizeof(text),
+             "info depth %d score %d nodes %lld nps %lld time %d pv",
+             info.depth, info.score, info.nodes, nps, info.ms);
+    string line = text;
+    for (int i = 0; i < info.lineLength; i++) {
+        line += " " + squareName(info.line[i]);
+    }
+    writeLine(line);
+}
+
+// Runs the extended protocol until "quit" or the end of the input.
+static void runExtended(Player *player) {
+    player->onInfo = writeInfo;
+    thread search;
+    atomic<bool> searching(false); // set while search is in doMove
+    int ponderSquare = -1; // reply named by the last "ponder"
+    string buffered;
+    string line;
+    while (readLine(&buffered, &line)) {
+        char command[16] = "";
+        sscanf(line.c_str(), "%15s", command);
+        if (!strcmp(command, "stop") && searching) {
+            player->stopSearch = true;
+            continue;
+        }
+        // every other command waits for the running search
+        if (search.joinable()) {
+            search.join();
+        }
+        if (!strcmp(command, "stop")) {
+            player->stopPondering(nullptr);
+            continue;
+        }
+        int x = -1, y = -1, msLeft = -1;
+        if (!strcmp(command, "quit")) {
+            break;
+        } else if (!strcmp(command, "newgame")) {
+            char side[16] = "", moves[256] = "";
+            sscanf(line.c_str(), "%*s %15s %255s", side, moves);
+            player->newGame(!strcmp(side, "black") ? BLACK : WHITE);
+            ponderSquare = -1;
+            if (!playOpening(player, moves)) {
+                cerr << "illegal opening " << moves << endl;
+            }
+            writeLine("ready");
+        } else if ((!strcmp(command, "move")
+                 && sscanf(line.c_str(), "%*s %d %d %d", &x, &y, &msLeft) == 3)
+                || (!strcmp(command, "ponderhit") && ponderSquare >= 0
+                 && sscanf(line.c_str(), "%*s %d", &msLeft) == 1)) {
+            bool passed = !strcmp(command, "move") && (x < 0 || y < 0);
+            if (!strcmp(command, "move") && !passed
+             && (x > 7 || y > 7)) {
+                cerr << "move off the board " << line << endl;
+                continue;
+            }
+            Move opponentsMove(x, y);
+            if (!strcmp(command, "ponderhit")) {
+                opponentsMove.square = ponderSquare;
+            }
+            player->stopSearch = false;
+            searching = true;
+            search = thread([=, &ponderSquare, &searching]() mutable {
+                Move *move = player->doMove(passed ? nullptr : &opponentsMove,
+                                            msLeft);
+                string reply = "bestmove -1 -1";
+                if (move != nullptr) {
+                    reply = "bestmove " + to_string(move->getX()) + " "
+                          + to_string(move->getY());
+                    delete move;
+                }
+                int ponder = player->ponderMove();
+                ponderSquare = (ponder >= 0 && ponder != NO_MOVE) ? ponder
+                                                                  : -1;
+                if (ponderSquare >= 0) {
+                    reply += " ponder " + to_string(ponderSquare & 7) + " "
+                           + to_string(ponderSquare >> 3);
+                }
+                searching = false;
+                writeLine(reply);
+            });
+        } else {
+            cerr << "unknown command " << line << endl;
+        }
+    }
+    player->stopSearch = true;
+    if (search.joinable()) {
+        search.join();
+    }
+}
+
 int main(int argc, char *argv[]) {
-    // Read in side the player is on.
-    if (argc != 2)  {
-        cerr << "usage: " << argv[0] << " side" << endl;
+    // Read in side the player is on, followed by any engine options.
+    if (argc < 2 || argc % 2 != 0)  {
+        cerr << "usage: " << argv[0] << " side [-hash MB] [-threads N]"
+             << " [-probcut 0|1] [-probcut-threshold SIGMAS] [-ponder 0|1]"
+             << " [-tree 0|1] [-verbose 0|1] [-opening MOVES]"
+             << " [-protocol default|extended]" << endl;
         exit(-1);
     }
     Side side = (!strcmp(argv[1], "Black")) ? BLACK : WHITE;
 
-    // Initialize player.
+    // Initialize player. Pondering is left off unless asked for with
+    // -ponder 1: the opponent usually runs on the same machine, and a
+    // ponder search on every core would take its time away.
     Player *player = new Player(side);
+    bool extended = false;
+    for (int i = 2; i < argc; i += 2) {
+        if (!strcmp(argv[i], "-hash")) {
+            player->setHashSize(atoi(argv[i + 1]));
+        } else if (!strcmp(argv[i], "-threads")) {
+            player->threads = atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "-probcut")) {
+            player->probcut.enabled = atoi(argv[i + 1]) != 0;
+        } else if (!strcmp(argv[i], "-probcut-threshold")) {
+            player->probcut.threshold = atof(argv[i + 1]);
+        } else if (!strcmp(argv[i], "-ponder")) {
+            player->ponder = atoi(argv[i + 1]) != 0;
+        } else if (!strcmp(argv[i], "-tree")) {
+            player->useTree = atoi(argv[i + 1]) != 0;
+        } else if (!strcmp(argv[i], "-verbose")) {
+            player->verbose = atoi(argv[i + 1]) != 0;
+        } else if (!strcmp(argv[i], "-opening")) {
+            // Start from the position after these moves, written like
+            // "f5d6c3d3", instead of the initial one.
+            if (!playOpening(player, argv[i + 1])) {
+                cerr << "illegal opening " << argv[i + 1] << endl;
+                exit(-1);
+            }
+        } else if (!strcmp(argv[i], "-protocol")) {
+            extended = !strcmp(argv[i + 1], "extended");
+        } else {
+            cerr << "unknown option " << argv[i] << endl;
+            exit(-1);
+        }
+    }
+
+    if (extended) {
+        writeLine("Init done");
+        runExtended(player);
+        delete player;
+        return 0;
+    }
 
     // Tell java wrapper that we are done initializing.
     cout << "Init done" << endl;
@@ -25,13 +264,20 @@ int main(int argc, char *argv[]) {
     while (cin >> moveX >> moveY >> msLeft) {
         Move *opponentsMove = nullptr;
         if (moveX >= 0 && moveY >= 0) {
+            if (moveX > 7 || moveY > 7) {
+                // Not a move the wrapper can have meant, and there is no
+                // way to ask again.
+                cerr << "move off the board " << moveX << " " << moveY
+                     << endl;
+                break;
+            }
             opponentsMove = new Move(moveX, moveY);
         }
 
         // Get player's move and output to java wrapper.
         Move *playersMove = player->doMove(opponentsMove, msLeft);
         if (playersMove != nullptr) {
-            cout << playersMove->x << " " << playersMove->y << endl;
+            cout << playersMove->getX() << " " << playersMove->getY() << endl;
         } else {
             cout << "-1 -1" << endl;
         }
@@ -43,5 +289,7 @@ int main(int argc, char *argv[]) {
         if (playersMove != nullptr) delete playersMove;
     }
 
+    // Stops the ponder search before exiting.
+    delete player;
     return 0;
 }